@@ -361,7 +361,7 @@ class SsrFlextBase : public flext_dsp
             error("%s - src model expects a string value!", thisName());
             return;
           }
-          source->model = model_str;
+          source->model = ssr::to_source_model(model_str);
         }
         else
         {
@@ -511,7 +511,8 @@ class SsrMex
           mexErrMsgTxt("Couldn't convert source model string!");
         }
         _engine->get_source(_get_source_id(i))->model
-          = model == LegacySource::plane ? "plane" : "point";
+          = model == LegacySource::plane
+          ? ssr::SourceModel::plane : ssr::SourceModel::point;
       }
     }
 
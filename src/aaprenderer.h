@@ -30,30 +30,41 @@
 #ifndef SSR_AAPRENDERER_H
 #define SSR_AAPRENDERER_H
 
+#include <cmath>  // for std::cos(), std::sin()
+
+#include "apf/math.h"  // for apf::math::deg2rad()
+
 #include "ssr_global.h"
-#include "loudspeakerrenderer.h"
-#include "apf/combine_channels.h"
+#include "ambisonicsrenderer.h"
+#include "ambisonicstools.h"  // for circular_modal_weights()
 
 namespace ssr
 {
 
-class AapRenderer : public SourceToOutput<AapRenderer, LoudspeakerRenderer>
+/** Ambisonics Amplitude Panning Renderer.
+ * The panning function (in-phase or basic) is a finite sum of circular
+ * harmonics.  Therefore, the sources are encoded into 2N+1 circular harmonic
+ * channels (N being the Ambisonics order), which are then decoded to the
+ * loudspeakers with a constant matrix that includes the modal weighting.
+ **/
+class AapRenderer : public AmbisonicsRenderer<AapRenderer>
 {
   private:
-    using _base = SourceToOutput<AapRenderer, ssr::LoudspeakerRenderer>;
+    using _base = AmbisonicsRenderer<AapRenderer>;
 
   public:
     static const char* name() { return "AAP-Renderer"; }
 
     class Source;
-    class SourceChannel;
-    class Output;
-    class RenderFunction;
+    using Output = _base::Output;
 
     explicit AapRenderer(const apf::parameter_map& params)
       : _base(params)
       , _ambisonics_order(params.get("ambisonics_order", 0))
       , _in_phase_rendering(params.get("in_phase", true))
+      , _reference_rotation(this->state.reference_rotation.get())
+      , _reference_azimuth(Orientation(_reference_rotation).azimuth)
+      , _reference_rotation_changed(false)
     {
       SSR_VERBOSE((_in_phase_rendering ? "U" : "Not u")
           << "sing in-phase rendering.");
@@ -61,107 +72,97 @@ class AapRenderer : public SourceToOutput<AapRenderer, LoudspeakerRenderer>
 
     APF_PROCESS(AapRenderer, _base)
     {
-      _process_list(_source_list);
+      _update_reference();
+      this->_process_list(_source_list);  // encoding gains
+      this->_process_list(_harmonic_list);  // encoding
+      // decoding is done in the outputs
     }
 
     void load_reproduction_setup();
 
   private:
+    void _update_reference();
+
     int _ambisonics_order;
     bool _in_phase_rendering;
-};
-
-class AapRenderer::Source : public _base::Source
-{
-  public:
-    Source(const Params& p)
-      : _base::Source(p, p.parent->get_output_list().size(), this)
-    {}
 
-    bool get_output_levels(sample_type* first, sample_type* last) const;
+    // The reference is checked once per block, sources only re-calculate
+    // their encoding gains if the reference (or the source) has moved.
+    apf::BlockParameter<Position> _reference_position;
+    Rot _reference_rotation;
+    float _reference_azimuth;  // degrees
+    bool _reference_rotation_changed;
 };
 
-class AapRenderer::SourceChannel
+void
+AapRenderer::_update_reference()
 {
-  public:
-    explicit SourceChannel(const Source* s)
-      : source(*s)
-    {}
-
-    const Source& source;
-
-    using iterator = decltype(source.begin());
-
-    iterator begin() const { return source.begin(); }
-    iterator end() const { return source.end(); }
-
-    apf::BlockParameter<sample_type> stored_weight;
-};
+  _reference_position = Position(this->state.reference_position);
 
+  const Rot& rotation = this->state.reference_rotation.get();
+  _reference_rotation_changed = rotation.x != _reference_rotation.x
+    || rotation.y != _reference_rotation.y
+    || rotation.z != _reference_rotation.z
+    || rotation.w != _reference_rotation.w;
 
-bool
-AapRenderer::Source::get_output_levels(sample_type* first
-    , sample_type* last) const
-{
-  assert(
-      static_cast<sourcechannels_t::size_type>(std::distance(first, last))
-      == this->sourcechannels.size());
-  (void)last;
-
-  for (const auto& channel: this->sourcechannels)
+  if (_reference_rotation_changed)
   {
-    *first = channel.stored_weight;
-    ++first;
+    _reference_rotation = rotation;
+    _reference_azimuth = Orientation(rotation).azimuth;
   }
-
-  return true;
 }
 
-class AapRenderer::RenderFunction
+class AapRenderer::Source : public _base::Source
 {
   public:
-    RenderFunction(const Output& out) : _out(out) {}
-
-    apf::CombineChannelsResult::type select(SourceChannel& in);
+    Source(const Params& p)
+      : _base::Source(p)
+    {}
 
-    sample_type operator()(sample_type in)
+    /// Encoding gains: [1, cos(theta), sin(theta), cos(2 theta), ...] times
+    /// the weighting factor
+    APF_PROCESS(Source, _base::Source)
     {
-      return in * _weight;
-    }
+      _position = Position(this->position);
 
-    sample_type operator()(sample_type in, sample_type index)
-    {
-      return in * _interpolator(index);
-    }
+      bool angle_changed = !_unit_gains_valid || _position.changed()
+        || this->parent._reference_position.changed()
+        || this->parent._reference_rotation_changed;
 
-  private:
-    sample_type _weight;
-    apf::math::linear_interpolator<sample_type> _interpolator;
+      if (angle_changed)
+      {
+        _update_unit_gains();
+      }
 
-    const Output& _out;
-};
+      _update_gains(angle_changed);
+    }
 
-class AapRenderer::Output : public _base::Output
-{
-  public:
-    Output(const Params& p)
-      : _base::Output(p)
-      , _combiner(this->sourcechannels, this->buffer)
+  private:
+    void _update_unit_gains()
     {
-      // TODO: add delay line (in some base class?)
+      // WARNING: The reference offset is currently broken!
 
-      // TODO: amplitude correction for misplaced loudspeakers?
-      //_weight = loudspeaker_distance / farthest_loudspeaker_distance;
-    }
+      float theta_pw = apf::math::deg2rad(((_position.get()
+              - this->parent._reference_position.get()).orientation()
+            - Orientation(this->parent._reference_azimuth)).azimuth);
 
-    APF_PROCESS(Output, _base::Output)
-    {
-      _combiner.process(RenderFunction(*this));
+      _unit_gains[0] = 1;
+
+      // cos(m*theta) and sin(m*theta) are obtained by repeated rotation
+      auto cos_1 = std::cos(theta_pw), sin_1 = std::sin(theta_pw);
+      auto cos_m = 1.0f, sin_m = 0.0f;
+      for (size_t i = 1; i < _unit_gains.size(); i += 2)
+      {
+        auto temp = cos_m * cos_1 - sin_m * sin_1;
+        sin_m = sin_m * cos_1 + cos_m * sin_1;
+        cos_m = temp;
+        _unit_gains[i] = cos_m;
+        _unit_gains[i + 1] = sin_m;
+      }
+      _unit_gains_valid = true;
     }
 
-  private:
-    apf::CombineChannelsInterpolation<apf::cast_proxy<SourceChannel
-      , sourcechannels_t>, buffer_type> _combiner;
+    apf::BlockParameter<Position> _position;
 };
 
 void
@@ -207,80 +208,40 @@ AapRenderer::load_reproduction_setup()
 
   SSR_VERBOSE("Using Ambisonics order " << _ambisonics_order << ".");
 
-  // TODO: more things?
-}
+  const int order = _ambisonics_order;
+  _harmonics = 2 * order + 1;
 
-apf::CombineChannelsResult::type
-AapRenderer::RenderFunction::select(SourceChannel& in)
-{
-  // TODO: take loudspeaker weight into account (for misplaced loudspeakers)?
-
-  using apf::math::deg2rad;
+  // Expand the panning function into circular harmonics
+  auto modal_weights = circular_modal_weights(order, _in_phase_rendering);
 
-  float two_times_order = 2 * _out.parent._ambisonics_order;
+  // TODO: take loudspeaker weight into account (for misplaced loudspeakers)?
 
-  auto weighting_factor = sample_type();
+  _decoder.assign(this->get_output_list().size() * _harmonics, 0);
 
-  if (_out.model == LegacyLoudspeaker::normal)
+  for (const auto& out: rtlist_proxy<Output>(this->get_output_list()))
   {
-    // WARNING: The reference offset is currently broken!
+    auto row = _decoder.begin() + out.index * _harmonics;
 
-    float alpha_0  = deg2rad((_out.position).orientation().azimuth);
-    float theta_pw = deg2rad(((Position(in.source.position) -
-            Position(_out.parent.state.reference_position)).orientation()
-          - Orientation(_out.parent.state.reference_rotation)).azimuth);
-
-    // TODO: wrap angles?
-
-    if (_out.parent._in_phase_rendering)
+    if (out.model == LegacyLoudspeaker::normal)
     {
-      weighting_factor = std::pow(std::cos((alpha_0 - theta_pw) / 2)
-          , two_times_order);
+      // WARNING: The reference offset is currently broken!
+      double alpha_0 = this->loudspeaker_geometry().array_angles[out.index];
+
+      row[0] = modal_weights[0];
+      for (int m = 1; m <= order; ++m)
+      {
+        row[2 * m - 1] = 2 * modal_weights[m] * std::cos(m * alpha_0);
+        row[2 * m] = 2 * modal_weights[m] * std::sin(m * alpha_0);
+      }
     }
     else
     {
-      // check numerical stability
-      if (std::abs(std::sin((alpha_0 - theta_pw) / 2)) < 0.0001f)
-      {
-        weighting_factor = 1;
-      }
-      else
-      {
-        weighting_factor
-          = std::sin((two_times_order + 1) * (alpha_0 - theta_pw) / 2) /
-           ((two_times_order + 1) * std::sin((alpha_0 - theta_pw) / 2));
-      }
+      // TODO: subwoofer gets weighting factor 1.0?
+      row[0] = 1;
     }
   }
-  else
-  {
-    // TODO: subwoofer gets weighting factor 1.0?
-    weighting_factor = 1;
-  }
-
-  // Apply source volume, mute, ...
-  weighting_factor *= in.source.weighting_factor;
-
-  in.stored_weight = weighting_factor;
 
-  auto old_weight = in.stored_weight.old();
-
-  using namespace apf::CombineChannelsResult;
-
-  if (old_weight == 0 && weighting_factor == 0)
-  {
-    return nothing;
-  }
-  else if (old_weight == weighting_factor)
-  {
-    _weight = weighting_factor;
-    return constant;
-  }
-  else
-  {
-    _interpolator.set(old_weight, weighting_factor, _out.parent.block_size());
-    return change;
-  }
+  _add_harmonic_channels();
 }
 
 }  // namespace ssr
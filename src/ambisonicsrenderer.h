@@ -0,0 +1,411 @@
+/******************************************************************************
+ * Copyright © 2019 SSR Contributors                                          *
+ *                                                                            *
+ * This file is part of the SoundScape Renderer (SSR).                        *
+ *                                                                            *
+ * The SSR is free software:  you can redistribute it and/or modify it  under *
+ * the terms of the  GNU  General  Public  License  as published by the  Free *
+ * Software Foundation, either version 3 of the License,  or (at your option) *
+ * any later version.                                                         *
+ *                                                                            *
+ * The SSR is distributed in the hope that it will be useful, but WITHOUT ANY *
+ * WARRANTY;  without even the implied warranty of MERCHANTABILITY or FITNESS *
+ * FOR A PARTICULAR PURPOSE.                                                  *
+ * See the GNU General Public License for more details.                       *
+ *                                                                            *
+ * You should  have received a copy  of the GNU General Public License  along *
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                            *
+ * The SSR is a tool  for  real-time  spatial audio reproduction  providing a *
+ * variety of rendering algorithms.                                           *
+ *                                                                            *
+ * http://spatialaudio.net/ssr                           ssr@spatialaudio.net *
+ ******************************************************************************/
+
+/// @file
+/// Parent class for Ambisonics renderers.
+
+#ifndef SSR_AMBISONICSRENDERER_H
+#define SSR_AMBISONICSRENDERER_H
+
+#include <algorithm>  // for std::copy(), std::fill(), std::all_of()
+#include <array>
+#include <numeric>  // for std::inner_product()
+#include <vector>
+
+#include "loudspeakerrenderer.h"
+
+namespace ssr
+{
+
+/** Parent class for Ambisonics renderers.
+ * The sources are encoded into a number of harmonic channels (the "harmonic
+ * bus"), which are decoded to the loudspeakers with a constant matrix.
+ * The @p Derived renderer sets #_harmonics and computes the decoding matrix
+ * (#_decoder) when loading the reproduction setup.  Its sources compute the
+ * encoding gains of the harmonics (without weighting factor) in each block.
+ **/
+template<typename Derived>
+class AmbisonicsRenderer : public LoudspeakerRenderer<Derived>
+{
+  private:
+    using _base = LoudspeakerRenderer<Derived>;
+
+  public:
+    using typename _base::sample_type;
+    using typename _base::rtlist_t;
+
+    class Source;
+    class HarmonicChannel;
+    class Output;
+
+    explicit AmbisonicsRenderer(const apf::parameter_map& params)
+      : _base(params)
+      , _harmonics(0)
+      , _harmonic_list(this->_fifo)
+    {}
+
+  protected:
+    void _add_harmonic_channels();
+
+    size_t _harmonics;
+
+    rtlist_t _harmonic_list;
+    std::vector<const HarmonicChannel*> _harmonic_channels;
+
+    /// Decoding matrix, indexed by [Output::index * _harmonics + harmonic]
+    std::vector<sample_type> _decoder;
+};
+
+/// Create one HarmonicChannel for each of the #_harmonics.
+template<typename Derived>
+void
+AmbisonicsRenderer<Derived>::_add_harmonic_channels()
+{
+  _harmonic_channels.clear();
+  for (size_t i = 0; i < _harmonics; ++i)
+  {
+    _harmonic_channels.push_back(
+        _harmonic_list.add(new HarmonicChannel(*this, i)));
+  }
+}
+
+/// A source with one encoding gain per harmonic channel.
+template<typename Derived>
+class AmbisonicsRenderer<Derived>::Source : public _base::Source
+{
+  public:
+    using typename _base::Source::Params;
+
+    explicit Source(const Params& p)
+      : _base::Source(p)
+      , old_gains(p.parent->_harmonics)
+      , gains(p.parent->_harmonics)
+      , _unit_gains(p.parent->_harmonics)
+      , _unit_gains_valid(false)
+      , _gains_changed(false)
+    {
+      assert(this->parent._harmonics > 0);
+    }
+
+    bool get_output_levels(sample_type* first, sample_type* last) const;
+
+    /// Encoding gains of the previous block (for interpolation)
+    std::vector<sample_type> old_gains;
+    /// Encoding gains of the current block
+    std::vector<sample_type> gains;
+
+  protected:
+    /// Update #gains once per block.
+    /// @param direction_changed @c true if #_unit_gains have been updated
+    void _update_gains(bool direction_changed)
+    {
+      if (_gains_changed)
+      {
+        std::copy(this->gains.begin(), this->gains.end()
+            , this->old_gains.begin());
+      }
+
+      // Apply source volume, mute, ...
+      _gains_changed = direction_changed || this->weighting_factor.changed();
+
+      if (_gains_changed)
+      {
+        sample_type weight = this->weighting_factor;
+        for (size_t i = 0; i < this->gains.size(); ++i)
+        {
+          this->gains[i] = weight * _unit_gains[i];
+        }
+      }
+    }
+
+    /// Harmonics of the current source direction (without weight)
+    std::vector<sample_type> _unit_gains;
+    bool _unit_gains_valid;
+
+  private:
+    bool _gains_changed;
+};
+
+/// The level of each output is obtained from the (cached) encoding gains and
+/// the decoding matrix, there is no need to process anything.
+template<typename Derived>
+bool
+AmbisonicsRenderer<Derived>::Source::get_output_levels(sample_type* first
+    , sample_type* last) const
+{
+  using out_list_t
+    = typename _base::template rtlist_proxy<typename Derived::Output>;
+
+  assert(size_t(std::distance(first, last))
+      == this->parent.get_output_list().size());
+  (void)last;
+
+  const auto& decoder = this->parent._decoder;
+
+  for (const auto& out: out_list_t(this->parent.get_output_list()))
+  {
+    auto row = decoder.begin() + out.index * this->gains.size();
+    *first = std::inner_product(this->gains.begin(), this->gains.end(), row
+        , sample_type());
+    ++first;
+  }
+
+  return true;
+}
+
+/// One channel of the harmonic bus, summing all encoded sources.
+template<typename Derived>
+class AmbisonicsRenderer<Derived>::HarmonicChannel
+                        : public _base::template ProcessItem<HarmonicChannel>
+{
+  private:
+    using _item = typename _base::template ProcessItem<HarmonicChannel>;
+
+  public:
+    HarmonicChannel(const AmbisonicsRenderer& parent, size_t harmonic)
+      : buffer(parent.block_size())
+      , _parent(parent)
+      , _harmonic(harmonic)
+    {}
+
+    // NB: The APF_PROCESS macro doesn't work here because of the template.
+    struct Process : _item::Process
+    {
+      explicit Process(HarmonicChannel& c)
+        : _item::Process(c)
+      {
+        c._encode();
+      }
+    };
+
+    apf::fixed_vector<sample_type> buffer;
+
+  private:
+    /// Number of sources which are mixed in one pass
+    static constexpr size_t _group = 4;
+
+    /// Sources which are mixed in one pass
+    struct SourceGroup
+    {
+      std::array<const sample_type*, _group> inputs;
+      std::array<sample_type, _group> gains, increments;
+      size_t size = 0;
+
+      /// @return @b true if the group is full
+      bool add(const sample_type* input, sample_type gain
+          , sample_type increment)
+      {
+        inputs[size] = input;
+        gains[size] = gain;
+        increments[size] = increment;
+        return ++size == _group;
+      }
+    };
+
+    void _encode();
+
+    /// Add @p N sources of @p group (starting at @p first) to #buffer.
+    /// @tparam Interpolate if @b false, the increments are ignored
+    template<size_t N, bool Interpolate>
+    void _mix(const SourceGroup& group, size_t first)
+    {
+      // Local copies and __restrict, otherwise the loop is not vectorized
+      std::array<const sample_type*, N> in;
+      std::array<sample_type, N> gain, increment;
+      for (size_t k = 0; k < N; ++k)
+      {
+        in[k] = group.inputs[first + k];
+        gain[k] = group.gains[first + k];
+        increment[k] = group.increments[first + k];
+      }
+      sample_type* __restrict out = &*this->buffer.begin();
+      const size_t size = _parent.block_size();
+      sample_type index = 0;  // no integer conversion inside of the loop
+      for (size_t n = 0; n < size; ++n, ++index)
+      {
+        sample_type sum = 0;
+        for (size_t k = 0; k < N; ++k)
+        {
+          if constexpr (Interpolate)
+          {
+            sum += in[k][n] * (gain[k] + index * increment[k]);
+          }
+          else
+          {
+            sum += in[k][n] * gain[k];
+          }
+        }
+        out[n] += sum;
+      }
+    }
+
+    const AmbisonicsRenderer& _parent;
+    const size_t _harmonic;
+};
+
+template<typename Derived>
+void
+AmbisonicsRenderer<Derived>::HarmonicChannel::_encode()
+{
+  using source_list_t
+    = typename _base::template rtlist_proxy<typename Derived::Source>;
+
+  StageTimer::Scope timer(_parent._stage_timer, StageTimer::combine);
+  std::fill(this->buffer.begin(), this->buffer.end(), sample_type());
+
+  const auto block_size = sample_type(_parent.block_size());
+
+  // Sources are mixed in groups, the buffer is only read and written once per
+  // group.  Sources with constant gains are grouped separately, they are
+  // cheaper to mix.
+  SourceGroup constant, interpolated;
+
+  for (const auto& source: source_list_t(_parent.get_source_list()))
+  {
+    auto old_gain = source.old_gains[_harmonic];
+    auto new_gain = source.gains[_harmonic];
+    const sample_type* input = &*source.begin();
+
+    if (old_gain == 0 && new_gain == 0)
+    {
+      // nothing
+    }
+    else if (old_gain == new_gain)
+    {
+      if (constant.add(input, new_gain, 0))
+      {
+        _mix<_group, false>(constant, 0);
+        constant.size = 0;
+      }
+    }
+    else if (interpolated.add(input, old_gain
+          , (new_gain - old_gain) / block_size))
+    {
+      _mix<_group, true>(interpolated, 0);
+      interpolated.size = 0;
+    }
+  }
+  for (size_t i = 0; i < constant.size; ++i)
+  {
+    _mix<1, false>(constant, i);
+  }
+  for (size_t i = 0; i < interpolated.size; ++i)
+  {
+    _mix<1, true>(interpolated, i);
+  }
+}
+
+/// The decoding matrix multiplication is split into rows (one per output),
+/// which are processed in parallel.  Each row is processed in groups of
+/// harmonic channels, the output buffer is only read and written once per
+/// group.
+template<typename Derived>
+class AmbisonicsRenderer<Derived>::Output : public _base::Output
+{
+  public:
+    using typename _base::Output::Params;
+
+    explicit Output(const Params& p)
+      : _base::Output(p)
+    {
+      // TODO: add delay line (in some base class?)
+
+      // TODO: amplitude correction for misplaced loudspeakers?
+      //_weight = loudspeaker_distance / farthest_loudspeaker_distance;
+    }
+
+    // NB: The APF_PROCESS macro doesn't work here because of the template.
+    struct Process : _base::Output::Process
+    {
+      explicit Process(Output& o)
+        : _base::Output::Process(o)
+      {
+        o._decode();
+      }
+    };
+
+  private:
+    /// Number of harmonic channels which are mixed in one pass
+    static constexpr size_t _group = 4;
+
+    void _decode();
+
+    /// Add @p N harmonic channels (times their coefficients) to the buffer.
+    template<size_t N, typename I>
+    void _mix(const HarmonicChannel* const* channels, I coefficients)
+    {
+      // Local copies and __restrict, otherwise the loop is not vectorized
+      std::array<const sample_type*, N> in;
+      std::array<sample_type, N> coefficient;
+      for (size_t k = 0; k < N; ++k)
+      {
+        in[k] = &*channels[k]->buffer.begin();
+        coefficient[k] = coefficients[k];
+      }
+      sample_type* __restrict out = &*this->buffer.begin();
+      const size_t size = this->parent.block_size();
+      for (size_t n = 0; n < size; ++n)
+      {
+        sample_type sum = 0;
+        for (size_t k = 0; k < N; ++k)
+        {
+          sum += in[k][n] * coefficient[k];
+        }
+        out[n] += sum;
+      }
+    }
+};
+
+template<typename Derived>
+void
+AmbisonicsRenderer<Derived>::Output::_decode()
+{
+  std::fill(this->buffer.begin(), this->buffer.end(), sample_type());
+
+  const auto& channels = this->parent._harmonic_channels;
+  const auto size = channels.size();
+  auto row = this->parent._decoder.begin() + this->index * size;
+
+  size_t i = 0;
+  for (; i + _group <= size; i += _group)
+  {
+    if (std::all_of(row + i, row + i + _group
+          , [](sample_type c) { return c == 0; }))
+    {
+      continue;
+    }
+    _mix<_group>(channels.data() + i, row + i);
+  }
+  for (; i < size; ++i)
+  {
+    if (row[i] != 0)
+    {
+      _mix<1>(channels.data() + i, row + i);
+    }
+  }
+}
+
+}  // namespace ssr
+
+#endif
@@ -0,0 +1,287 @@
+/******************************************************************************
+ * Copyright © 2019 SSR Contributors                                          *
+ *                                                                            *
+ * This file is part of the SoundScape Renderer (SSR).                        *
+ *                                                                            *
+ * The SSR is free software:  you can redistribute it and/or modify it  under *
+ * the terms of the  GNU  General  Public  License  as published by the  Free *
+ * Software Foundation, either version 3 of the License,  or (at your option) *
+ * any later version.                                                         *
+ *                                                                            *
+ * The SSR is distributed in the hope that it will be useful, but WITHOUT ANY *
+ * WARRANTY;  without even the implied warranty of MERCHANTABILITY or FITNESS *
+ * FOR A PARTICULAR PURPOSE.                                                  *
+ * See the GNU General Public License for more details.                       *
+ *                                                                            *
+ * You should  have received a copy  of the GNU General Public License  along *
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                            *
+ * The SSR is a tool  for  real-time  spatial audio reproduction  providing a *
+ * variety of rendering algorithms.                                           *
+ *                                                                            *
+ * http://spatialaudio.net/ssr                           ssr@spatialaudio.net *
+ ******************************************************************************/
+
+/// @file
+/// Circular/spherical harmonics and decoder design for Ambisonics renderers.
+
+#ifndef SSR_AMBISONICSTOOLS_H
+#define SSR_AMBISONICSTOOLS_H
+
+#include <algorithm>  // for std::max(), std::fill()
+#include <cmath>  // for std::cos(), std::sin(), std::sqrt()
+#include <cstdlib>  // for std::abs()
+#include <vector>
+
+#include "apf/math.h"  // for apf::math::pi(), apf::math::deg2rad()
+
+#include "geometry.h"  // for vec3
+#include "triangulation.h"  // for triangulate(), find_triangle()
+
+namespace ssr
+{
+
+/** Modal weights of a circular panning function of order @p order.
+ * The panning function is a finite sum of circular harmonics:
+ * w[0] + 2 sum_m w[m] cos(m x).
+ *
+ * in-phase: cos^(2N)(x/2) = 2^(-2N) (binom(2N, N)
+ *                             + 2 sum_m binom(2N, N-m) cos(m x))
+ *
+ * basic: sin((2N+1) x/2) / ((2N+1) sin(x/2))
+ *          = (1 + 2 sum_m cos(m x)) / (2N+1)
+ **/
+inline std::vector<double>
+circular_modal_weights(int order, bool in_phase)
+{
+  auto weights = std::vector<double>(order + 1);
+  if (in_phase)
+  {
+    // binom(2N, N) / 2^(2N)
+    weights[0] = 1.0;
+    for (int i = 1; i <= order; ++i)
+    {
+      weights[0] *= (2.0 * i - 1.0) / (2.0 * i);
+    }
+    for (int m = 1; m <= order; ++m)
+    {
+      // binom(2N, N-m) / binom(2N, N-m+1) = (N-m+1) / (N+m)
+      weights[m] = weights[m - 1] * (order - m + 1) / (order + m);
+    }
+  }
+  else
+  {
+    std::fill(weights.begin(), weights.end(), 1.0 / (2 * order + 1));
+  }
+  return weights;
+}
+
+/// max-rE weights for 3D decoding: P_n(cos(137.9 degrees / (N + 1.51))).
+inline std::vector<double>
+max_re_weights(int order)
+{
+  auto weights = std::vector<double>(order + 1, 1.0);
+  double x = std::cos(apf::math::deg2rad(137.9 / (order + 1.51)));
+  double p_previous = 1, p = x;
+  for (int n = 1; n <= order; ++n)
+  {
+    weights[n] = p;
+    auto p_next = ((2 * n + 1) * x * p - n * p_previous) / (n + 1);
+    p_previous = p;
+    p = p_next;
+  }
+  return weights;
+}
+
+/// Real spherical harmonics up to a given order (ACN channel order, N3D
+/// normalization).
+class SphericalHarmonics
+{
+  public:
+    explicit SphericalHarmonics(int order = 0)
+      : _order(order)
+      , _normalization((order + 1) * (order + 1))
+    {
+      for (int n = 0; n <= _order; ++n)
+      {
+        for (int m = -n; m <= n; ++m)
+        {
+          // (n - |m|)! / (n + |m|)!
+          double ratio = 1;
+          for (int i = n - std::abs(m) + 1; i <= n + std::abs(m); ++i)
+          {
+            ratio /= i;
+          }
+          _normalization[n * n + n + m]
+            = std::sqrt((2 * n + 1) * (m == 0 ? 1 : 2) * ratio);
+        }
+      }
+    }
+
+    int order() const { return _order; }
+
+    /// Number of harmonics, (N+1)^2
+    size_t size() const { return _normalization.size(); }
+
+    /// Evaluate all harmonics for @p direction (which doesn't have to be
+    /// normalized).  This doesn't allocate memory.
+    /// @param out Destination for size() values
+    template<typename Iterator>
+    void operator()(const vec3& direction, Iterator out) const;
+
+  private:
+    int _order;
+    std::vector<double> _normalization;  // in ACN order
+};
+
+template<typename Iterator>
+void
+SphericalHarmonics::operator()(const vec3& direction, Iterator out) const
+{
+  double x = direction[0], y = direction[1], z = direction[2];
+  double horizontal = std::sqrt(x * x + y * y);
+  double r = std::sqrt(horizontal * horizontal + z * z);
+
+  double sin_elevation = 0, cos_elevation = 1, cos_azimuth = 1, sin_azimuth = 0;
+  if (r > 0)
+  {
+    sin_elevation = z / r;
+    cos_elevation = horizontal / r;
+  }
+  if (horizontal > 0)
+  {
+    cos_azimuth = x / horizontal;
+    sin_azimuth = y / horizontal;
+  }
+
+  // associated Legendre functions P_n^m(sin_elevation) are obtained by
+  // recursion over n (for each m), cos(m*azimuth) and sin(m*azimuth) by
+  // repeated rotation.
+
+  double cos_m = 1, sin_m = 0;  // cos(m*azimuth), sin(m*azimuth)
+  double p_mm = 1;  // P_m^m
+
+  for (int m = 0; m <= _order; ++m)
+  {
+    if (m > 0)
+    {
+      p_mm *= (2 * m - 1) * cos_elevation;
+      auto temp = cos_m * cos_azimuth - sin_m * sin_azimuth;
+      sin_m = sin_m * cos_azimuth + cos_m * sin_azimuth;
+      cos_m = temp;
+    }
+
+    double p_previous = 0;  // P_(n-1)^m
+    double p = p_mm;  // P_n^m
+
+    for (int n = m; n <= _order; ++n)
+    {
+      if (n > m)
+      {
+        auto p_next = ((2 * n - 1) * sin_elevation * p
+            - (n + m - 1) * p_previous) / (n - m);
+        p_previous = p;
+        p = p_next;
+      }
+      auto acn = n * n + n + m;
+      out[acn] = _normalization[acn] * p * cos_m;
+      if (m > 0)
+      {
+        acn = n * n + n - m;
+        out[acn] = _normalization[acn] * p * sin_m;
+      }
+    }
+  }
+}
+
+/// Decoding matrix computed by allrad_decoder()
+struct AllRadDecoder
+{
+  /// One row of SphericalHarmonics::size() coefficients per loudspeaker
+  std::vector<double> matrix;
+  size_t triangles = 0;  ///< Number of loudspeaker triangles
+  size_t virtual_loudspeakers = 0;
+};
+
+/** All-Round Ambisonic Decoder.
+ * A dense, nearly uniform set of virtual loudspeakers (on a spherical
+ * Fibonacci lattice) is decoded with a sampling decoder and then panned to
+ * the real loudspeakers with 3D VBAP.
+ * See Franz Zotter and Matthias Frank, "All-Round Ambisonic Panning and
+ * Decoding", Journal of the Audio Engineering Society (JAES), Vol.60(10),
+ * October 2012.
+ *
+ * Imaginary loudspeakers close the hull of (hemi-)spherical and horizontal
+ * setups, their signals are discarded.
+ *
+ * @param directions Normalized loudspeaker directions
+ * @param harmonics Defines the order
+ * @param modal_weights One weight per order, e.g. max_re_weights()
+ * @throw std::logic_error if the loudspeakers can't be triangulated
+ **/
+inline AllRadDecoder
+allrad_decoder(std::vector<vec3> directions
+    , const SphericalHarmonics& harmonics
+    , const std::vector<double>& modal_weights)
+{
+  const auto loudspeakers = directions.size();
+  const auto order = harmonics.order();
+  const auto size = harmonics.size();
+
+  bool has_bottom = false, has_top = false;
+  for (const auto& direction: directions)
+  {
+    if (direction[2] < -0.5f) has_bottom = true;
+    if (direction[2] > 0.5f) has_top = true;
+  }
+  if (!has_bottom) directions.push_back(vec3{0.0f, 0.0f, -1.0f});
+  if (!has_top) directions.push_back(vec3{0.0f, 0.0f, 1.0f});
+
+  auto triangles = triangulate(directions);
+
+  auto result = AllRadDecoder();
+  result.triangles = triangles.size();
+  result.virtual_loudspeakers = std::max(size_t(2000), 20 * size);
+  result.matrix.assign(loudspeakers * size, 0.0);
+
+  const auto virtual_loudspeakers = result.virtual_loudspeakers;
+  const double golden_angle
+    = apf::math::pi<double>() * (3.0 - std::sqrt(5.0));
+
+  auto values = std::vector<double>(size);
+
+  for (size_t j = 0; j < virtual_loudspeakers; ++j)
+  {
+    double z = 1.0 - (2.0 * j + 1.0) / virtual_loudspeakers;
+    double r = std::sqrt(1.0 - z * z);
+    double phi = j * golden_angle;
+    auto direction = vec3{float(r * std::cos(phi)), float(r * std::sin(phi))
+      , float(z)};
+
+    harmonics(direction, values.begin());
+
+    auto [triangle, gains] = find_triangle(triangles, direction);
+
+    for (size_t i = 0; i < 3; ++i)
+    {
+      auto ls = triangles[triangle].loudspeakers[i];
+      if (ls >= loudspeakers || gains[i] == 0)
+      {
+        continue;  // imaginary loudspeaker
+      }
+      for (int n = 0; n <= order; ++n)
+      {
+        for (int acn = n * n; acn < (n + 1) * (n + 1); ++acn)
+        {
+          result.matrix[ls * size + acn] += gains[i] * modal_weights[n]
+            * values[acn] / virtual_loudspeakers;
+        }
+      }
+    }
+  }
+  return result;
+}
+
+}  // namespace ssr
+
+#endif
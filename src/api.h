@@ -28,6 +28,7 @@
 #ifndef SSR_API_H
 #define SSR_API_H
 
+#include <cstddef>  // for size_t
 #include <cstdint>  // for uint32_t
 #include <memory>  // for std::unique_ptr
 #include <string>
@@ -298,6 +299,39 @@ struct CpuLoad
 };
 
 
+/// Continuous updates about the processing time of the renderer, separately
+/// for each processing stage and audio thread, and about the handling of
+/// high-rate parameter updates (e.g. from head trackers).
+/// The processing times are only available if DSP timing is enabled in the
+/// configuration.
+/// @see SubscribeHelper::dsp_timing()
+struct DspTiming
+{
+  virtual ~DspTiming() = default;
+
+  /// Processing time of one stage, for each audio thread.
+  /// @param stage Name of the stage: "inputs", "prepare", "sources",
+  ///   "combine", "outputs" or "metering".  Stages can overlap, e.g.
+  ///   "metering" is also part of "sources" and "outputs".
+  /// @param begin Pointer to the load of the first thread, in percent of the
+  ///   elapsed time (averaged since the previous update)
+  /// @param end Past-the-end pointer
+  virtual void stage_load(const std::string& stage, float* begin, float* end)
+    = 0;
+
+  /// Counters of the parameter updates which bypass the command queue
+  /// (source position/rotation/gain, reference position/rotation), since
+  /// the start of the renderer.  This is only sent if they have changed.
+  /// @param received Values received from the controller
+  /// @param coalesced Values which were replaced by a newer one before the
+  ///   audio thread took them over
+  /// @param applied Values taken over by the audio thread
+  /// @param pending Values still waiting for the audio thread
+  virtual void parameter_updates(size_t received, size_t coalesced
+      , size_t applied, size_t pending) = 0;
+};
+
+
 /// Interface for controlling an SSR instance.
 /// Its renderer can be controlled with RendererControlEvents.
 /// If the instance is itself a "follower", the SceneControlEvents are
@@ -448,6 +482,9 @@ struct SubscribeHelper
   /// Subscribe to CpuLoad.
   virtual std::unique_ptr<Subscription> cpu_load(
       CpuLoad* subscriber) = 0;
+  /// Subscribe to DspTiming.
+  virtual std::unique_ptr<Subscription> dsp_timing(
+      DspTiming* subscriber) = 0;
 };
 
 
@@ -322,6 +322,7 @@ class BinauralRenderer::Output : public _base::Output
 
     APF_PROCESS(Output, _base::Output)
     {
+      StageTimer::Scope timer(this->parent._stage_timer, StageTimer::combine);
       _combiner.process(RenderFunction());
     }
 
@@ -408,7 +409,7 @@ void BinauralRenderer::Source::_process()
   float source_distance = length(src_pos - ref_pos);
 
   if (this->weighting_factor != 0 && source_distance < 0.5f
-        && this->model != "plane")
+        && this->model != SourceModel::plane)
   {
     interp_factor = 1.0f - 2 * source_distance;
   }
@@ -422,7 +423,7 @@ void BinauralRenderer::Source::_process()
   vec3 selector{};
   // Rotation to compensate for the reference rotation
   auto anti_ref_rot = conj(ref_rot);
-  if (this->model == "plane")
+  if (this->model == SourceModel::plane)
   {
     // Relative source rotation, as seen from the reference
     auto rel_rot = anti_ref_rot * src_rot;
@@ -0,0 +1,277 @@
+/******************************************************************************
+ * Copyright © 2019 SSR Contributors                                          *
+ *                                                                            *
+ * This file is part of the SoundScape Renderer (SSR).                        *
+ *                                                                            *
+ * The SSR is free software:  you can redistribute it and/or modify it  under *
+ * the terms of the  GNU  General  Public  License  as published by the  Free *
+ * Software Foundation, either version 3 of the License,  or (at your option) *
+ * any later version.                                                         *
+ *                                                                            *
+ * The SSR is distributed in the hope that it will be useful, but WITHOUT ANY *
+ * WARRANTY;  without even the implied warranty of MERCHANTABILITY or FITNESS *
+ * FOR A PARTICULAR PURPOSE.                                                  *
+ * See the GNU General Public License for more details.                       *
+ *                                                                            *
+ * You should  have received a copy  of the GNU General Public License  along *
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                            *
+ * The SSR is a tool  for  real-time  spatial audio reproduction  providing a *
+ * variety of rendering algorithms.                                           *
+ *                                                                            *
+ * http://spatialaudio.net/ssr                           ssr@spatialaudio.net *
+ ******************************************************************************/
+
+/// @file
+/// Several independent cascades of second order sections, processed in lanes.
+
+#ifndef SSR_BIQUADLANES_H
+#define SSR_BIQUADLANES_H
+
+#include <algorithm>  // for std::min(), std::fill_n(), std::count_if(), ...
+#include <cassert>  // for assert()
+#include <functional>  // for std::greater
+#include <iterator>  // for std::distance()
+#include <stdexcept>  // for std::logic_error
+#include <vector>
+
+namespace ssr
+{
+
+/** Bank of independent IIR cascades ("lanes") sharing one input signal.
+ * All lanes are processed one section after the other for the whole block,
+ * the innermost loop runs over the lanes.  There is no dependency between
+ * lanes, which allows the compiler to vectorize this loop.
+ *
+ * Each lane can have a different number of sections, but the lanes have to be
+ * sorted by decreasing number of sections.  This way, the lanes which are
+ * still active in a given section are always the first ones.
+ *
+ * New coefficients are not applied immediately, they are linearly
+ * interpolated during the next call to execute().  The interpolated
+ * coefficients are updated once per ramp (a few samples), not per sample.
+ *
+ * The sections are implemented in Direct Form II, like apf::BiQuad.
+ **/
+template<typename T>
+class BiQuadLanes
+{
+  public:
+    /// Constructor.
+    /// @param sections number of sections for each lane
+    /// @param block_size maximum number of samples passed to execute()
+    /// @param ramp_size number of samples with constant coefficients during
+    ///   interpolation
+    /// @throw std::logic_error if @p sections is not sorted properly
+    BiQuadLanes(const std::vector<size_t>& sections, size_t block_size
+        , size_t ramp_size = 16)
+      : _lanes(sections.size())
+      , _sections(sections)
+      , _block_size(block_size)
+      , _ramp_size(ramp_size)
+      , _size(0)
+      , _ramping(false)
+      , _data(block_size * _lanes)
+    {
+      if (!std::is_sorted(sections.begin(), sections.end()
+            , std::greater<size_t>()))
+      {
+        throw std::logic_error(
+            "BiQuadLanes: Lanes must have decreasing number of sections!");
+      }
+      if (_ramp_size == 0)
+      {
+        throw std::logic_error("BiQuadLanes: ramp_size must not be zero!");
+      }
+
+      size_t total_sections = _lanes ? sections.front() : 0;
+      for (size_t s = 0; s < total_sections; ++s)
+      {
+        // number of lanes which have at least s + 1 sections
+        _active.push_back(static_cast<size_t>(std::count_if(sections.begin()
+                , sections.end(), [s] (size_t n) { return n > s; })));
+      }
+
+      for (auto* c: {&_current, &_target, &_delta})
+      {
+        c->resize(total_sections * _lanes);
+      }
+      _w1.resize(total_sections * _lanes);
+      _w2.resize(total_sections * _lanes);
+    }
+
+    size_t lanes() const { return _lanes; }
+
+    /// Set new coefficients for all sections of one lane.
+    /// @param lane index of the lane
+    /// @param first begin of a range of apf::SosCoefficients (or similar)
+    /// @param last end of the range
+    template<typename I>
+    void set(size_t lane, I first, I last)
+    {
+      assert(lane < _lanes);
+      assert(size_t(std::distance(first, last)) == _sections[lane]);
+
+      for (size_t i = lane; first != last; ++first, i += _lanes)
+      {
+        _target.b0[i] = first->b0;
+        _target.b1[i] = first->b1;
+        _target.b2[i] = first->b2;
+        _target.a1[i] = first->a1;
+        _target.a2[i] = first->a2;
+      }
+      _ramping = true;
+    }
+
+    /// Filter one block of input samples with all lanes.
+    template<typename I>
+    void execute(I first, I last)
+    {
+      _size = static_cast<size_t>(std::distance(first, last));
+      assert(_size <= _block_size);
+
+      // All lanes get the same input signal
+      for (size_t n = 0; n < _size; ++n, ++first)
+      {
+        std::fill_n(_data.begin() + n * _lanes, _lanes, T(*first));
+      }
+
+      size_t ramps = (_size + _ramp_size - 1) / _ramp_size;
+
+      for (size_t s = 0; s < _active.size(); ++s)
+      {
+        size_t offset = s * _lanes;
+
+        if (_ramping)
+        {
+          _delta.set_difference(_target, _current, offset, _active[s], ramps);
+        }
+
+        for (size_t begin = 0; begin < _size; begin += _ramp_size)
+        {
+          if (_ramping && begin > 0)
+          {
+            _current.add(_delta, offset, _active[s]);
+          }
+          _process_section(offset, _active[s], begin
+              , std::min(begin + _ramp_size, _size));
+        }
+
+        if (_ramping)
+        {
+          // Avoid accumulation of rounding errors
+          _current.copy(_target, offset, _active[s]);
+        }
+      }
+      _ramping = false;
+    }
+
+    /// Copy the output of one lane (from the last call to execute()).
+    template<typename O>
+    O copy_lane(size_t lane, O result) const
+    {
+      assert(lane < _lanes);
+      for (size_t i = lane; i < _size * _lanes; i += _lanes)
+      {
+        *result++ = _data[i];
+      }
+      return result;
+    }
+
+  private:
+    /// Coefficients of all sections of all lanes, one array per coefficient.
+    struct Coefficients
+    {
+      std::vector<T> b0, b1, b2, a1, a2;
+
+      void resize(size_t size)
+      {
+        for (auto* v: {&b0, &b1, &b2, &a1, &a2}) v->resize(size);
+      }
+
+      void set_difference(const Coefficients& a, const Coefficients& b
+          , size_t offset, size_t lanes, size_t steps)
+      {
+        for (size_t i = offset; i < offset + lanes; ++i)
+        {
+          b0[i] = (a.b0[i] - b.b0[i]) / steps;
+          b1[i] = (a.b1[i] - b.b1[i]) / steps;
+          b2[i] = (a.b2[i] - b.b2[i]) / steps;
+          a1[i] = (a.a1[i] - b.a1[i]) / steps;
+          a2[i] = (a.a2[i] - b.a2[i]) / steps;
+        }
+      }
+
+      void add(const Coefficients& other, size_t offset, size_t lanes)
+      {
+        for (size_t i = offset; i < offset + lanes; ++i)
+        {
+          b0[i] += other.b0[i];
+          b1[i] += other.b1[i];
+          b2[i] += other.b2[i];
+          a1[i] += other.a1[i];
+          a2[i] += other.a2[i];
+        }
+      }
+
+      void copy(const Coefficients& other, size_t offset, size_t lanes)
+      {
+        std::copy_n(other.b0.begin() + offset, lanes, b0.begin() + offset);
+        std::copy_n(other.b1.begin() + offset, lanes, b1.begin() + offset);
+        std::copy_n(other.b2.begin() + offset, lanes, b2.begin() + offset);
+        std::copy_n(other.a1.begin() + offset, lanes, a1.begin() + offset);
+        std::copy_n(other.a2.begin() + offset, lanes, a2.begin() + offset);
+      }
+    };
+
+    /// Run one section of the first @p lanes lanes on samples [begin, end).
+    void _process_section(size_t offset, size_t lanes, size_t begin
+        , size_t end)
+    {
+      for (size_t n = begin; n < end; ++n)
+      {
+        // Denormal prevention, similar to apf::dp::ac
+        const T dc = (n % 2) ? T(1e-18) : T(-1e-18);
+
+        _process_sample(_data.data() + n * _lanes
+            , _current.b0.data() + offset, _current.b1.data() + offset
+            , _current.b2.data() + offset, _current.a1.data() + offset
+            , _current.a2.data() + offset
+            , _w1.data() + offset, _w2.data() + offset, lanes, dc);
+      }
+    }
+
+    /// One sample of one section for several lanes.
+    /// The written arrays never overlap with anything else, without telling
+    /// the compiler (with __restrict) the loop is not vectorized.
+    static void _process_sample(T* __restrict x
+        , const T* b0, const T* b1, const T* b2, const T* a1, const T* a2
+        , T* __restrict w1, T* __restrict w2, size_t lanes, T dc)
+    {
+      for (size_t l = 0; l < lanes; ++l)
+      {
+        T w0 = x[l] - a1[l] * w1[l] - a2[l] * w2[l] + dc;
+        x[l] = b0[l] * w0 + b1[l] * w1[l] + b2[l] * w2[l];
+        w2[l] = w1[l];
+        w1[l] = w0;
+      }
+    }
+
+    const size_t _lanes;
+    const std::vector<size_t> _sections;
+    const size_t _block_size, _ramp_size;
+    size_t _size;  ///< Number of samples in the last block
+    bool _ramping;
+
+    /// Number of active lanes for each section
+    std::vector<size_t> _active;
+    Coefficients _current, _target, _delta;
+    /// Filter states, same layout as the coefficients
+    std::vector<T> _w1, _w2;
+    /// Interleaved samples of all lanes, processed in-place
+    std::vector<T> _data;
+};
+
+}  // namespace ssr
+
+#endif
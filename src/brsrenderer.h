@@ -48,6 +48,9 @@ class BrsRenderer : public SourceToOutput<BrsRenderer, RendererBase>
   public:
     static const char* name() { return "BrsRenderer"; }
 
+    /// The distance attenuation is part of the impulse responses
+    static constexpr bool distance_attenuation = false;
+
     using Input = _base::DefaultInput;
     class Source;
     struct SourceChannel;
@@ -265,6 +268,7 @@ class BrsRenderer::Output : public _base::Output
 
     APF_PROCESS(Output, _base::Output)
     {
+      StageTimer::Scope timer(this->parent._stage_timer, StageTimer::combine);
       _combiner.process(RenderFunction());
     }
 
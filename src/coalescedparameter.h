@@ -0,0 +1,155 @@
+/******************************************************************************
+ * Copyright © 2019 SSR Contributors                                          *
+ *                                                                            *
+ * This file is part of the SoundScape Renderer (SSR).                        *
+ *                                                                            *
+ * The SSR is free software:  you can redistribute it and/or modify it  under *
+ * the terms of the  GNU  General  Public  License  as published by the  Free *
+ * Software Foundation, either version 3 of the License,  or (at your option) *
+ * any later version.                                                         *
+ *                                                                            *
+ * The SSR is distributed in the hope that it will be useful, but WITHOUT ANY *
+ * WARRANTY;  without even the implied warranty of MERCHANTABILITY or FITNESS *
+ * FOR A PARTICULAR PURPOSE.                                                  *
+ * See the GNU General Public License for more details.                       *
+ *                                                                            *
+ * You should  have received a copy  of the GNU General Public License  along *
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                            *
+ * The SSR is a tool  for  real-time  spatial audio reproduction  providing a *
+ * variety of rendering algorithms.                                           *
+ *                                                                            *
+ * http://spatialaudio.net/ssr                           ssr@spatialaudio.net *
+ ******************************************************************************/
+
+/// @file
+/// Parameters which only keep their latest value, bypassing the command queue.
+
+#ifndef SSR_COALESCEDPARAMETER_H
+#define SSR_COALESCEDPARAMETER_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>  // for size_t
+
+namespace ssr
+{
+
+/// Counters for all CoalescedParameter%s of a renderer.
+struct CoalescingStatistics
+{
+  /// Snapshot of the counters.
+  struct Counters
+  {
+    size_t updates;    ///< Values written by the control thread
+    size_t coalesced;  ///< Values overwritten before they were applied
+    size_t applied;    ///< Values taken over by the audio thread
+
+    /// Number of values waiting for the audio thread
+    size_t pending() const
+    {
+      // The counters are not read atomically, avoid wrap-around:
+      return updates > coalesced + applied ? updates - coalesced - applied : 0;
+    }
+  };
+
+  Counters get() const
+  {
+    return {updates.load(std::memory_order_relaxed)
+      , coalesced.load(std::memory_order_relaxed)
+      , applied.load(std::memory_order_relaxed)};
+  }
+
+  std::atomic<size_t> updates{0}, coalesced{0}, applied{0};
+};
+
+/** Parameter written by the control thread and read by the audio thread.
+ * Unlike apf::SharedData, an assignment doesn't push a command to the
+ * apf::CommandQueue.  Only the latest value is kept (in a lock-free triple
+ * buffer), values which are overwritten before the audio thread takes them
+ * over are simply dropped.  This is meant for parameters which are updated at
+ * high rates (e.g. by head trackers) where only the newest value matters.
+ *
+ * After each assignment, @p bit is set in the @p dirty bitmap which is shared
+ * with the other parameters of the same object.  The audio thread checks this
+ * bitmap once per block and calls update() for all parameters that changed.
+ *
+ * Note: The order of updates relative to commands in the apf::CommandQueue
+ * (and relative to other CoalescedParameter%s) is not preserved.
+ *
+ * Only one thread may assign values at a time, only one (other) thread may
+ * call update(), get() and set_from_rt_thread().
+ **/
+template<typename T>
+class CoalescedParameter
+{
+  public:
+    CoalescedParameter(std::atomic<unsigned>& dirty, unsigned bit
+        , CoalescingStatistics& statistics, const T& value = T())
+      : _dirty(dirty)
+      , _bit(bit)
+      , _statistics(statistics)
+      , _buffers{{value, value, value}}
+    {}
+
+    CoalescedParameter(const CoalescedParameter&) = delete;
+    CoalescedParameter& operator=(const CoalescedParameter&) = delete;
+
+    /// Set new value (control thread).
+    CoalescedParameter& operator=(const T& value)
+    {
+      _buffers[_back] = value;
+      auto old = _middle.exchange(_back | _fresh, std::memory_order_acq_rel);
+      _back = old & _index;
+
+      _statistics.updates.fetch_add(1, std::memory_order_relaxed);
+      if (old & _fresh)
+      {
+        _statistics.coalesced.fetch_add(1, std::memory_order_relaxed);
+      }
+      _dirty.fetch_or(_bit, std::memory_order_release);
+      return *this;
+    }
+
+    /// Take over the latest value, if there is a new one (audio thread).
+    /// @return @b true if the value has changed.
+    bool update()
+    {
+      if (!(_middle.load(std::memory_order_relaxed) & _fresh))
+      {
+        return false;
+      }
+      // Only the audio thread resets _fresh, so it is still set
+      auto old = _middle.exchange(_front, std::memory_order_acq_rel);
+      _front = old & _index;
+      _statistics.applied.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+
+    /// Overwrite the current value from the audio thread.
+    /// A pending value from the control thread still has precedence.
+    void set_from_rt_thread(const T& value)
+    {
+      _buffers[_front] = value;
+    }
+
+    const T& get() const { return _buffers[_front]; }
+    operator const T&() const { return this->get(); }
+
+  private:
+    static constexpr unsigned _index = 3;  // bit mask for buffer index
+    static constexpr unsigned _fresh = 4;  // flag for unread value
+
+    std::atomic<unsigned>& _dirty;
+    const unsigned _bit;
+    CoalescingStatistics& _statistics;
+
+    std::array<T, 3> _buffers;
+    unsigned _back = 0;  // only used by the control thread
+    unsigned _front = 1;  // only used by the audio thread
+    std::atomic<unsigned> _middle{2};
+};
+
+}  // namespace ssr
+
+#endif
@@ -171,8 +171,12 @@ ssr::conf_struct ssr::configuration(int& argc, char* argv[])
   // for WFS renderer
   conf.renderer_params.set("prefilter_file"
       , SSR_DATA_DIR"/default_wfs_prefilter.wav");
-  conf.renderer_params.set("delayline_size", 100000); // in samples
+  conf.renderer_params.set("delayline_size", 0); // "0" means from geometry
+  conf.renderer_params.set("max_source_distance", 100.0f); // meters
+  conf.renderer_params.set("grow_delaylines", true);
   conf.renderer_params.set("initial_delay", 1000);    // in samples
+  conf.renderer_params.set("prefilter_placement", "input");
+  conf.renderer_params.set("pipelined", false);
 
   // for binaural renderer
   conf.renderer_params.set("hrir_size", 0); // "0" means use all that are there
@@ -181,6 +185,7 @@ ssr::conf_struct ssr::configuration(int& argc, char* argv[])
   // for AAP renderer
   conf.renderer_params.set("ambisonics_order", 0); // "0" means use maximum that makes sense
   conf.renderer_params.set("in_phase", false);
+  conf.renderer_params.set("hoa_max_re", true);
   conf.tracker = "";
 
   // USB ports have to be checked first!
@@ -188,6 +193,12 @@ ssr::conf_struct ssr::configuration(int& argc, char* argv[])
 
   conf.loop = false; // temporary solution!
 
+  conf.fftw_wisdom_file = "";  // default: don't load or save wisdom
+  conf.train_fft = false;
+  conf.lock_memory = false;
+  conf.huge_pages = false;
+  conf.renderer_params.set("planner_effort", "patient");
+
   // load system-wide config file (Mac)
   load_config_file("/Library/SoundScapeRenderer/ssr.conf",conf);
   // load system-wide config file (Linux et al.)
@@ -218,8 +229,12 @@ ssr::conf_struct ssr::configuration(int& argc, char* argv[])
 "      --hrir-size=N   Truncate HRIRs to length N\n"
 "      --prefilter=FILE\n"
 "                      Load WFS prefilter from FILE\n"
+"      --prefilter-placement=WHERE\n"
+"                      Apply WFS prefilter per \"input\" (default),\n"
+"                      per \"output\" or choose \"auto\"matically\n"
 "  -o, --ambisonics-order=VALUE\n"
-"                      Ambisonics order to use for AAP (default: maximum)\n"
+"                      Ambisonics order to use for AAP and HOA\n"
+"                      (default: maximum)\n"
 "      --in-phase-rendering\n"
 "                      Use in-phase rendering for AAP renderer\n"
 "\n"
@@ -235,6 +250,15 @@ ssr::conf_struct ssr::configuration(int& argc, char* argv[])
 "  -c, --config=FILE   Read configuration from FILE\n"
 "  -s, --setup=FILE    Load reproduction setup from FILE\n"
 "      --threads=N     Number of audio threads (default: auto)\n"
+"      --fftw-wisdom=FILE\n"
+"                      Load FFTW wisdom from FILE and save it on exit\n"
+"      --planner-effort=EFFORT\n"
+"                      FFTW planner effort: estimate, measure,\n"
+"                      patient (default) or exhaustive\n"
+"      --train-fft     Create all FFT plans for the current block size,\n"
+"                      save them to the FFTW wisdom file and exit\n"
+"      --lock-memory   Lock all memory in RAM (avoids page faults)\n"
+"      --huge-pages    Use transparent huge pages for large allocations\n"
 "  -r, --record=FILE   Record the audio output of the renderer to FILE\n"
 "      --decay-exponent=VALUE\n"
 "                      Exponent that determines the amplitude decay "
@@ -345,6 +369,7 @@ ssr::conf_struct ssr::configuration(int& argc, char* argv[])
     {"hrirs",        required_argument, nullptr,  0 },
     {"hrir-size",    required_argument, nullptr,  0 },
     {"prefilter",    required_argument, nullptr,  0 },
+    {"prefilter-placement", required_argument, nullptr, 0 },
     {"ambisonics-order",required_argument,nullptr,'o'},
     {"in-phase-rendering", no_argument, nullptr,  0 },
 
@@ -356,6 +381,11 @@ ssr::conf_struct ssr::configuration(int& argc, char* argv[])
     {"config",       required_argument, nullptr, 'c'},
     {"setup",        required_argument, nullptr, 's'},
     {"threads",      required_argument, nullptr,  0 },
+    {"fftw-wisdom",  required_argument, nullptr,  0 },
+    {"planner-effort", required_argument, nullptr,  0 },
+    {"train-fft",    no_argument,       nullptr,  0 },
+    {"lock-memory",  no_argument,       nullptr,  0 },
+    {"huge-pages",   no_argument,       nullptr,  0 },
     {"record",       required_argument, nullptr, 'r'},
     {"decay-exponent", required_argument, nullptr,  0 },
     {"loop",         no_argument,       nullptr,  0 },
@@ -414,6 +444,10 @@ ssr::conf_struct ssr::configuration(int& argc, char* argv[])
         {
           conf.renderer_params.set("prefilter_file", optarg);
         }
+        else if (strcmp("prefilter-placement", longopts[longindex].name) == 0)
+        {
+          conf.renderer_params.set("prefilter_placement", optarg);
+        }
         else if (strcmp("in-phase-rendering", longopts[longindex].name) == 0)
         {
           conf.renderer_params.set("in_phase", true);
@@ -430,6 +464,27 @@ ssr::conf_struct ssr::configuration(int& argc, char* argv[])
         {
           conf.renderer_params.set("threads", optarg);
         }
+        else if (strcmp("fftw-wisdom", longopts[longindex].name) == 0)
+        {
+          conf.fftw_wisdom_file = optarg;
+        }
+        else if (strcmp("planner-effort", longopts[longindex].name) == 0)
+        {
+          conf.renderer_params.set("planner_effort", optarg);
+        }
+        else if (strcmp("train-fft", longopts[longindex].name) == 0)
+        {
+          conf.train_fft = true;
+        }
+        else if (strcmp("lock-memory", longopts[longindex].name) == 0)
+        {
+          conf.lock_memory = true;
+        }
+        else if (strcmp("huge-pages", longopts[longindex].name) == 0)
+        {
+          conf.huge_pages = true;
+          conf.renderer_params.set("huge_pages", true);
+        }
         else if (strcmp("decay-exponent", longopts[longindex].name) == 0)
         {
           conf.renderer_params.set("decay_exponent", optarg);
@@ -621,6 +676,21 @@ ssr::conf_struct ssr::configuration(int& argc, char* argv[])
 
   conf.renderer_params.set("xml_schema", conf.xml_schema);
 
+  if (conf.train_fft)
+  {
+    if (conf.fftw_wisdom_file == "")
+    {
+      throw std::logic_error(
+          "--train-fft needs a wisdom file (use --fftw-wisdom=FILE)!");
+    }
+    // Nobody has to wait for this, so we can take all the time we need
+    auto effort = conf.renderer_params.get<std::string>("planner_effort");
+    if (effort != "exhaustive")
+    {
+      conf.renderer_params.set("planner_effort", "patient");
+    }
+  }
+
   if (conf.freewheeling)
   {
     conf.renderer_params.set("freewheeling", true);
@@ -777,6 +847,23 @@ int ssr::load_config_file(const char *filename, conf_struct& conf){
     {
       conf.renderer_params.set("threads", value);
     }
+    else if (!strcmp(key, "THREAD_CPUS"))
+    {
+      conf.renderer_params.set("thread_cpus", value);
+    }
+    else if (!strcmp(key, "THREAD_PRIORITY"))
+    {
+      conf.renderer_params.set("thread_priority", value);
+    }
+    else if (!strcmp(key, "NUMA_NODE"))
+    {
+      conf.renderer_params.set("numa_node", value);
+    }
+    else if (!strcmp(key, "DSP_TIMING"))
+    {
+      if (!strcasecmp(value, "yes")) conf.renderer_params.set("dsp_timing", true);
+      else conf.renderer_params.set("dsp_timing", false);
+    }
     else if (!strcmp(key, "MASTER_VOLUME_CORRECTION"))
     {
       conf.renderer_params.set("master_volume_correction", value);
@@ -826,11 +913,49 @@ int ssr::load_config_file(const char *filename, conf_struct& conf){
       conf.renderer_params.set("prefilter_file"
           , make_path_relative_to_current_dir(value, filename));
     }
+    else if (!strcmp(key, "WFS_PREFILTER_PLACEMENT"))
+    {
+      conf.renderer_params.set("prefilter_placement", value);
+    }
+    else if (!strcmp(key, "SOURCE_POOL_SIZE"))
+    {
+      conf.renderer_params.set("source_pool_size", value);
+    }
+    else if (!strcmp(key, "EXPECTED_SOURCES"))
+    {
+      conf.renderer_params.set("expected_sources", value);
+    }
+    else if (!strcmp(key, "SOURCE_SLAB_SIZE"))
+    {
+      conf.renderer_params.set("source_slab_size", value);
+    }
     else if (!strcmp(key, "DELAYLINE_SIZE"))
     {
       conf.renderer_params.set("delayline_size", value);
       assert(conf.renderer_params.get<int>("delayline_size") >= 0);
     }
+    else if (!strcmp(key, "MIXING_TILE_OUTPUTS"))
+    {
+      conf.renderer_params.set("mixing_tile_outputs", value);
+    }
+    else if (!strcmp(key, "MIXING_TILE_SOURCES"))
+    {
+      conf.renderer_params.set("mixing_tile_sources", value);
+    }
+    else if (!strcmp(key, "WFS_PIPELINED"))
+    {
+      if (!strcasecmp(value, "yes")) conf.renderer_params.set("pipelined", true);
+      else conf.renderer_params.set("pipelined", false);
+    }
+    else if (!strcmp(key, "MAX_SOURCE_DISTANCE"))
+    {
+      conf.renderer_params.set("max_source_distance", value);
+    }
+    else if (!strcmp(key, "GROW_DELAYLINES"))
+    {
+      if (!strcasecmp(value, "yes")) conf.renderer_params.set("grow_delaylines", true);
+      else conf.renderer_params.set("grow_delaylines", false);
+    }
     else if (!strcmp(key, "INITIAL_DELAY"))
     {
       conf.renderer_params.set("initial_delay", value);
@@ -859,6 +984,31 @@ int ssr::load_config_file(const char *filename, conf_struct& conf){
       else SSR_ERROR("I don't understand the option '" << value
           << "' for in-phase rendering.");
     }
+    else if (!strcmp(key, "HOA_MAX_RE"))
+    {
+      if (!strcasecmp(value, "TRUE")) conf.renderer_params.set("hoa_max_re", true);
+      else if (!strcasecmp(value, "FALSE")) conf.renderer_params.set("hoa_max_re", false);
+      else SSR_ERROR("I don't understand the option '" << value
+          << "' for max-rE weighting.");
+    }
+    else if (!strcmp(key, "FFTW_WISDOM_FILE"))
+    {
+      conf.fftw_wisdom_file
+        = make_path_relative_to_current_dir(value, filename);
+    }
+    else if (!strcmp(key, "FFTW_PLANNER_EFFORT"))
+    {
+      conf.renderer_params.set("planner_effort", value);
+    }
+    else if (!strcmp(key, "LOCK_MEMORY"))
+    {
+      conf.lock_memory = !strcasecmp(value, "yes");
+    }
+    else if (!strcmp(key, "HUGE_PAGES"))
+    {
+      conf.huge_pages = !strcasecmp(value, "yes");
+      conf.renderer_params.set("huge_pages", conf.huge_pages);
+    }
     else if (!strcmp(key, "INPUT_PREFIX"))
     {
       conf.input_port_prefix = value;
@@ -79,6 +79,11 @@ struct conf_struct
   bool in_phase_rendering;
 
   bool loop; ///< temporary solution for looping sound files
+
+  std::string fftw_wisdom_file;         ///< load/save FFTW wisdom (or "")
+  bool train_fft;                       ///< create FFT plans, save and exit
+  bool lock_memory;                     ///< mlockall() and prefault memory
+  bool huge_pages;                      ///< huge pages for large allocations
 };
 
 conf_struct configuration(int& argc, char* argv[]);
@@ -34,6 +34,8 @@
 #include <config.h> // for ENABLE_*, HAVE_*, WITH_*
 #endif
 
+#include <chrono>  // for std::chrono::steady_clock
+#include <cmath>  // for std::round()
 #include <functional>  // for std::function
 #include <type_traits>  // for std::is_same_v
 #include <regex>
@@ -55,6 +57,8 @@
 
 #include "xmlparser.h"
 #include "configuration.h"
+#include "fftwisdom.h"  // for FftWisdom
+#include "memorylock.h"  // for MemoryLock
 
 #ifdef ENABLE_GUI
 #include "qgui.h"
@@ -163,10 +167,32 @@ class Controller : public api::Publisher
     bool _load_dynamic_asdf(const std::string& scene_file_name);
 #endif
 
+    /// Properties of a source which is about to be created.
+    struct NewSource
+    {
+      std::string id;
+      std::string name;
+      std::string model;
+      std::string file_name_or_port_number;
+      int channel;
+      Pos position;
+      Rot rotation;
+      bool fixed;
+      float volume;
+      bool mute;
+      std::string properties_file;
+      // These are set by _prepare_source():
+      std::string port_name{};
+      long int file_length = 0;
+    };
+
     void _new_source(const std::string& id, const std::string& name
       , const std::string& model, const std::string& file_name_or_port_number
       , int channel, const Pos& position, const Rot& rotation, bool fixed
       , float volume, bool mute, const std::string& properties_file);
+    void _new_sources(std::vector<NewSource> sources);
+    bool _prepare_source(NewSource& source);
+    void _publish_new_source(const std::string& id, const NewSource& source);
 
     void _delete_all_sources();
 
@@ -300,6 +326,10 @@ class Controller : public api::Publisher
     int _argc;
     char** _argv;
     conf_struct _conf;
+    // NB: This must be initialized before the renderer creates any FFT plans
+    FftWisdom _fft_wisdom;
+    // NB: This must be initialized before the renderer allocates DSP memory
+    MemoryLock _memory_lock;
 
     Scene _scene;
     LegacyScene _legacy_scene;
@@ -317,7 +347,8 @@ class Controller : public api::Publisher
       Subscribers<api::SourceMetering>,
       Subscribers<api::MasterMetering>,
       Subscribers<api::OutputActivity>,
-      Subscribers<api::CpuLoad>
+      Subscribers<api::CpuLoad>,
+      Subscribers<api::DspTiming>
     > _subscribers;
     api::Controller* _leader = nullptr;
 #ifdef ENABLE_GUI
@@ -383,6 +414,10 @@ Controller<Renderer>::Controller(int argc, char* argv[])
   : _argc(argc)
   , _argv(argv)
   , _conf(configuration(_argc, _argv))
+  , _fft_wisdom(_conf.fftw_wisdom_file)
+  // Worker threads plus the JACK thread
+  , _memory_lock(_conf.lock_memory, _conf.huge_pages
+      , _conf.renderer_params.get("threads", size_t(1)) + 1)
   , _renderer(_conf.renderer_params)
   , _rendersubscriber(_renderer)
   , _query_state(query_state(*this, _renderer))
@@ -464,6 +499,9 @@ Controller<Renderer>::Controller(int argc, char* argv[])
       , _renderer.name());
 
   _renderer.load_reproduction_setup();
+  // NB: This must not be done anymore after the renderer is activated
+  _memory_lock.advise_huge_pages();
+  _memory_lock.check_limit(1);  // The JACK thread is created in activate()
 
   _publish(&api::RendererInformationEvents::loudspeakers, _get_loudspeakers());
 
@@ -477,6 +515,9 @@ Controller<Renderer>::Controller(int argc, char* argv[])
         , _conf.auto_rotate_sources);
     _publish(&api::SceneInformationEvents::sample_rate
         , _renderer.sample_rate());
+
+    // Register JACK ports for sources in advance (if SOURCE_POOL_SIZE > 0)
+    _renderer.fill_input_pool();
   }
 
   if (_conf.freewheeling)
@@ -622,6 +663,19 @@ class Controller<Renderer>::query_state
       // Start a scoped bundle, don't echo events to RenderSubscriber
       auto control = _controller.take_control(&_controller._rendersubscriber);
 
+      _controller._renderer.housekeeping();
+
+      std::string errors;
+      auto threads = _controller._renderer.report_thread_layout(errors);
+      if (!threads.empty())
+      {
+        SSR_VERBOSE_NOLF(threads);
+      }
+      if (!errors.empty())
+      {
+        SSR_WARNING("Unable to set up audio thread(s):\n" << errors);
+      }
+
       if (!_controller._conf.follow)
       {
 #ifdef ENABLE_DYNAMIC_ASDF
@@ -717,6 +771,32 @@ class Controller<Renderer>::query_state
         _controller._publish(&api::CpuLoad::cpu_load, cpu_load);
         _controller._cpu_load = cpu_load;
       }
+
+      // Averaging over many blocks keeps the number of messages low
+      auto now = std::chrono::steady_clock::now();
+      if (now - _dsp_timing_time >= std::chrono::milliseconds(500))
+      {
+        _dsp_timing_time = now;
+        if (_controller._renderer.get_dsp_timing(_dsp_loads))
+        {
+          for (size_t stage = 0; stage < _dsp_loads.size(); ++stage)
+          {
+            auto& loads = _dsp_loads[stage];
+            _controller._publish(&api::DspTiming::stage_load
+                , std::string(StageTimer::name(stage))
+                , loads.data(), loads.data() + loads.size());
+          }
+        }
+        auto counters = _controller._renderer.get_coalescing_statistics();
+        if (counters.updates != _parameter_updates.updates
+            || counters.applied != _parameter_updates.applied)
+        {
+          _parameter_updates = counters;
+          _controller._publish(&api::DspTiming::parameter_updates
+              , counters.updates, counters.coalesced, counters.applied
+              , counters.pending());
+        }
+      }
       _controller._publish(&api::MasterMetering::master_level, _master_level);
 
       if (!_discard_source_levels)
@@ -780,6 +860,10 @@ class Controller<Renderer>::query_state
     source_levels_t _source_levels;
     bool _discard_source_levels = true;
     size_t _new_size = 0;
+
+    std::chrono::steady_clock::time_point _dsp_timing_time;
+    std::vector<std::vector<float>> _dsp_loads;
+    CoalescingStatistics::Counters _parameter_updates{};
 #ifdef ENABLE_DYNAMIC_ASDF
     std::unique_ptr<dynamic_source_list_t> _dynamic_sources;
     dynamic_source_list_t _old_dynamic_sources;
@@ -791,6 +875,20 @@ class Controller<Renderer>::query_state
 template<typename Renderer>
 bool Controller<Renderer>::run()
 {
+  if (_conf.train_fft)
+  {
+    // All FFT plans for the reproduction setup (and the scene, if given) have
+    // been created in the constructor.
+    if (!_fft_wisdom.save())
+    {
+      throw std::runtime_error("Unable to save FFTW wisdom!");
+    }
+    std::cout << "FFTW wisdom for a block size of " << _renderer.block_size()
+      << " has been saved to \"" << _fft_wisdom.file_name() << "\"."
+      << std::endl;
+    return true;
+  }
+
   _start_tracker(_conf.tracker, _conf.tracker_ports);
 
   // TODO: make sleep time customizable
@@ -799,6 +897,12 @@ bool Controller<Renderer>::run()
     return false;
   }
 
+  auto thread_layout = _renderer.describe_thread_layout();
+  if (!thread_layout.empty())
+  {
+    SSR_VERBOSE("Audio thread layout: " << thread_layout);
+  }
+
   {
     auto control = this->take_control();
     control->processing(true);
@@ -891,6 +995,23 @@ Controller<Renderer>::~Controller()
   }
 
   _renderer.deactivate();
+
+  auto counters = _renderer.get_coalescing_statistics();
+  SSR_VERBOSE("Parameter updates: " << counters.updates << " received, "
+      << counters.coalesced << " coalesced, " << counters.applied
+      << " applied, " << counters.pending() << " pending.");
+
+  auto utilization = _renderer.get_thread_utilization();
+  if (!utilization.empty())
+  {
+    std::string report;
+    for (auto u: utilization)
+    {
+      report += " " + apf::str::A2S(std::round(100 * u)) + "%";
+    }
+    SSR_VERBOSE("Audio thread utilization (sources):" << report);
+  }
+
   if (!_conf.follow)
   {
     auto control = this->take_control();
@@ -1573,6 +1694,12 @@ private:
     });
   }
 
+  std::unique_ptr<api::Subscription>
+  dsp_timing(api::DspTiming* subscriber) override
+  {
+    return _subscribe_helper(subscriber);
+  }
+
   Controller<Renderer>& _controller;
   std::lock_guard<std::mutex> _lock;
 };
@@ -1807,6 +1934,7 @@ Controller<Renderer>::_load_scene(const std::string& scene_file_name)
     xpath_result = scene_file->eval_xpath("//scene_setup/source");
     if (xpath_result)
     {
+      std::vector<NewSource> new_sources;
       for (Node node; (node = xpath_result->node()); ++(*xpath_result))
       {
         std::string name  = node.get_attribute("name");
@@ -1863,11 +1991,13 @@ Controller<Renderer>::_load_scene(const std::string& scene_file_name)
         pos_ptr->fixed = internal::get_attribute_of_node(node, "fixed", false);
 
         // NB: If ID is not the empty string and not unique, this will fail:
-        _new_source(id, name, model, file_name_or_port_number
+        new_sources.push_back({id, name, model, file_name_or_port_number
             , channel, Pos{pos_ptr->x, pos_ptr->y}
             , *dir_ptr, pos_ptr->fixed
-            , apf::math::dB2linear(gain_dB), muted, properties_file);
+            , apf::math::dB2linear(gain_dB), muted, properties_file});
       }
+      // All sources are handed to the renderer at once
+      _new_sources(std::move(new_sources));
     }
     else
     {
@@ -2245,23 +2375,91 @@ Controller<Renderer>::_new_source(id_t requested_id, const std::string& name
       , int channel, const Pos& position, const Rot& rotation, bool fixed
       , float volume, bool mute, const std::string& properties_file)
 {
-
   // TODO: similar function for follower? just using a JACK port, no audio file
 
+  _new_sources({{requested_id, name, model, file_name_or_port_number, channel
+      , position, rotation, fixed, volume, mute, properties_file}});
+}
+
+/** Create several sources at once.
+ * The renderer creates all sources with a single realtime handshake.
+ * Sources with invalid properties are skipped.
+ * If the renderer cannot create all of them, they are created one by one,
+ * skipping only the faulty ones.
+ **/
+template<typename Renderer>
+void
+Controller<Renderer>::_new_sources(std::vector<NewSource> sources)
+{
   assert(!_conf.follow);
 
-  std::string id = requested_id;
+  auto prepared = std::vector<NewSource>();
+  auto requests = std::vector<typename Renderer::SourceRequest>();
+  prepared.reserve(sources.size());
+  requests.reserve(sources.size());
+
+  for (auto& source: sources)
+  {
+    if (!_prepare_source(source))
+    {
+      continue;
+    }
+    apf::parameter_map p;
+    p.set("connect-to", source.port_name);
+    p.set("properties-file", source.properties_file);
+    requests.push_back({source.id, std::move(p)});
+    prepared.push_back(std::move(source));
+  }
+
+  if (requests.empty())
+  {
+    return;
+  }
 
-  if (id != "" && !std::regex_match(id, _re_ncname))
+  std::vector<std::string> ids;
+  try
+  {
+    ids = _renderer.add_sources(requests);
+  }
+  catch (std::exception& e)
   {
-    SSR_ERROR("Invalid source ID: " << id);
+    if (requests.size() == 1)
+    {
+      SSR_ERROR(e.what());
+      return;
+    }
+    for (auto& source: prepared)
+    {
+      _new_sources({std::move(source)});
+    }
     return;
   }
+  assert(ids.size() == prepared.size());
+
+  for (size_t i = 0; i < ids.size(); ++i)
+  {
+    assert(prepared[i].id.size() == 0 || prepared[i].id == ids[i]);
+    _publish_new_source(ids[i], prepared[i]);
+  }
+}
+
+/** Check the ID of a new source and get its audio file or JACK port.
+ * @return @b false if the source cannot be created
+ **/
+template<typename Renderer>
+bool
+Controller<Renderer>::_prepare_source(NewSource& source)
+{
+  if (source.id != "" && !std::regex_match(source.id, _re_ncname))
+  {
+    SSR_ERROR("Invalid source ID: " << source.id);
+    return false;
+  }
 
-  std::string port_name;
-  long int file_length = 0;
+  source.port_name = "";
+  source.file_length = 0;
 
-  if (channel > 0) // we're dealing with a soundfile
+  if (source.channel > 0) // we're dealing with a soundfile
   {
 #ifdef ENABLE_ECASOUND
     // if not already running, start AudioPlayer
@@ -2269,68 +2467,65 @@ Controller<Renderer>::_new_source(id_t requested_id, const std::string& name
     {
       _audio_player = AudioPlayer::ptr_t(new AudioPlayer);
     }
-    port_name = _audio_player->get_port_name(file_name_or_port_number, channel
+    source.port_name = _audio_player->get_port_name(
+        source.file_name_or_port_number, source.channel
     // the thing with _loop is a temporary hack, should be removed some time:
         , _loop);
-    file_length = _audio_player->get_file_length(file_name_or_port_number);
+    source.file_length = _audio_player->get_file_length(
+        source.file_name_or_port_number);
 #else
-    SSR_ERROR("Couldn't open audio file \"" << file_name_or_port_number
+    SSR_ERROR("Couldn't open audio file \"" << source.file_name_or_port_number
         << "\"! Ecasound was disabled at compile time.");
-    return;
+    return false;
 #endif
   }
   else  // no audio file
   {
-    assert(channel == 0);
+    assert(source.channel == 0);
 
-    if (file_name_or_port_number != "")
+    if (source.file_name_or_port_number != "")
     {
-      port_name = _conf.input_port_prefix + file_name_or_port_number;
+      source.port_name = _conf.input_port_prefix
+        + source.file_name_or_port_number;
     }
   }
 
-  if (port_name == "")
+  if (source.port_name == "")
   {
     SSR_VERBOSE("No audio file or port specified for source");
   }
+  return true;
+}
 
-  apf::parameter_map p;
-  p.set("connect-to", port_name);
-  p.set("properties-file", properties_file);
-  try
-  {
-    id = _renderer.add_source(id, p);
-  }
-  catch (std::exception& e)
-  {
-    SSR_ERROR(e.what());
-    return;
-  }
-  assert(requested_id.size() == 0 || requested_id == id);
-
+/// Announce a source which has just been created by the renderer.
+template<typename Renderer>
+void
+Controller<Renderer>::_publish_new_source(const std::string& id
+    , const NewSource& source)
+{
   _publish(&api::SceneInformationEvents::new_source, id);
   _publish(&api::SceneInformationEvents::source_property
-      , id, "port-name", port_name);
+      , id, "port-name", source.port_name);
 
-  if (file_name_or_port_number != "")
+  if (source.file_name_or_port_number != "")
   {
     _publish(&api::SceneInformationEvents::source_property
-        , id, "audio-file", file_name_or_port_number);
+        , id, "audio-file", source.file_name_or_port_number);
     _publish(&api::SceneInformationEvents::source_property
-        , id, "audio-file-channel", apf::str::A2S(channel));
+        , id, "audio-file-channel", apf::str::A2S(source.channel));
     _publish(&api::SceneInformationEvents::source_property
-        , id, "audio-file-length", apf::str::A2S(file_length));
+        , id, "audio-file-length", apf::str::A2S(source.file_length));
   }
   _publish(&api::SceneInformationEvents::source_property
-      , id, "properties-file", properties_file);
-
-  _publish(&api::SceneControlEvents::source_name, id, name);
-  _publish(&api::SceneControlEvents::source_model, id, model);
-  _publish(&api::SceneControlEvents::source_position, id, position);
-  _publish(&api::SceneControlEvents::source_rotation, id, rotation);
-  _publish(&api::SceneControlEvents::source_fixed, id, fixed);
-  _publish(&api::SceneControlEvents::source_volume, id, volume);
-  _publish(&api::SceneControlEvents::source_mute, id, mute);
+      , id, "properties-file", source.properties_file);
+
+  _publish(&api::SceneControlEvents::source_name, id, source.name);
+  _publish(&api::SceneControlEvents::source_model, id, source.model);
+  _publish(&api::SceneControlEvents::source_position, id, source.position);
+  _publish(&api::SceneControlEvents::source_rotation, id, source.rotation);
+  _publish(&api::SceneControlEvents::source_fixed, id, source.fixed);
+  _publish(&api::SceneControlEvents::source_volume, id, source.volume);
+  _publish(&api::SceneControlEvents::source_mute, id, source.mute);
   _publish(&api::SceneControlEvents::source_active, id, true);
 }
 
@@ -2340,6 +2535,10 @@ Controller<Renderer>::_delete_all_sources()
 {
   assert(!_conf.follow);
 
+  // Remove all sources from the renderer with a single realtime handshake,
+  // the renderer ignores the subsequent delete_source() calls.
+  _renderer.rem_all_sources();
+
   std::string id;
   while (!(id = _scene.get_source_id(1)).empty())
   {
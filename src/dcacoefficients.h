@@ -30,10 +30,12 @@
 #ifndef SSR_DCACASCADE_H
 #define SSR_DCACASCADE_H
 
-#include <cmath>  // for std::pow()
+#include <algorithm>  // for std::min()
+#include <cmath>  // for std::pow(), std::log2(), std::ceil()
 
 #include "apf/biquad.h"
 #include "apf/iterator.h"
+#include "apf/stringtools.h"  // for apf::str::A2S()
 
 namespace ssr
 {
@@ -166,6 +168,79 @@ class DcaCoefficients : public std::vector<apf::SosCoefficients<T>>
     const float _speed_of_sound;
 };
 
+/** Pre-calculated DcaCoefficients for point sources.
+ * The coefficients are calculated on a logarithmically spaced grid of
+ * distances, starting at the array radius.  Coefficients between grid points
+ * are linearly interpolated.  Since every section is stable at both grid
+ * points, the interpolated section is stable as well.
+ **/
+template<typename T>
+class DcaCoefficientTable
+{
+  public:
+    /// Constructor.
+    /// @param order mode number
+    /// @param octaves number of octaves above @p array_radius
+    /// @param steps_per_octave resolution of the distance grid
+    /// @throw std::logic_error if desired order is not supported.
+    DcaCoefficientTable(size_t order, size_t sample_rate, float array_radius
+        , float speed_of_sound, size_t octaves = 10
+        , size_t steps_per_octave = 24)
+      : _min_distance(array_radius)
+      , _max_distance(array_radius * std::pow(2.0f, float(octaves)))
+      , _steps_per_octave(steps_per_octave)
+      , _size(octaves * steps_per_octave + 1)
+    {
+      auto c = DcaCoefficients<T>(order, sample_rate, array_radius
+          , speed_of_sound);
+      _sections = c.size();
+      _entries.reserve(_size * _sections);
+
+      for (size_t i = 0; i < _size; ++i)
+      {
+        c.reset(_min_distance * std::pow(2.0f, float(i) / steps_per_octave)
+            , DcaCoefficients<T>::point_source);
+        _entries.insert(_entries.end(), c.begin(), c.end());
+      }
+    }
+
+    /// Interpolate coefficients for a point source.
+    /// @param distance source distance
+    /// @param[out] result coefficients, must have the same order as the table
+    /// @return @b false if @p distance is outside of the table, in this case
+    ///   @p result is not changed.
+    bool lookup(float distance, DcaCoefficients<T>& result) const
+    {
+      assert(result.size() == _sections);
+
+      // Note: this is also false for NaN
+      if (!(distance >= _min_distance && distance <= _max_distance))
+      {
+        return false;
+      }
+
+      T position = std::log2(distance / _min_distance) * _steps_per_octave;
+      size_t index = std::min(size_t(position), _size - 2);
+      T weight = position - index;
+
+      auto first = _entries.begin() + index * _sections;
+      auto second = first + _sections;
+
+      for (size_t i = 0; i < _sections; ++i)
+      {
+        result[i] = first[i] + weight * (second[i] - first[i]);
+      }
+      return true;
+    }
+
+  private:
+    const float _min_distance, _max_distance;
+    const size_t _steps_per_octave;
+    const size_t _size;  ///< Number of grid points
+    size_t _sections;
+    std::vector<apf::SosCoefficients<T>> _entries;
+};
+
 }  // namespace ssr
 
 #endif
@@ -38,6 +38,9 @@
 #include "ssr_global.h"  // for ssr::c
 #include "loudspeakerrenderer.h"
 #include "dcacoefficients.h"
+#include "biquadlanes.h"
+#include "sourcearena.h"  // for SourceArena
+#include "fftwisdom.h"  // for fftw_planner_flag()
 
 namespace ssr
 {
@@ -51,14 +54,12 @@ class DcaRenderer : public LoudspeakerRenderer<DcaRenderer>
   public:
     static const char* name() { return "DCA-Renderer"; }
 
-    using matrix_t = apf::fixed_matrix<sample_type>;
     using fft_matrix_t
       = apf::fixed_matrix<sample_type, apf::fftw_allocator<sample_type>>;
-    using filter_type = apf::Cascade<apf::BiQuad<double, apf::dp::ac>>;
+    using filter_type = BiQuadLanes<double>;
 
     class Source;
     class Mode;
-    class ModePair;
     struct ModeAccumulatorBase;
     template<typename I1, typename I2> class ModeAccumulator;
     class FftProcessor;
@@ -67,7 +68,8 @@ class DcaRenderer : public LoudspeakerRenderer<DcaRenderer>
 
     DcaRenderer(const apf::parameter_map& params)
       : _base(params)
-      , _mode_pair_list(_fifo)
+      , _planner_flag(fftw_planner_flag(
+            params.get<std::string>("planner_effort", "patient")))
       , _mode_accumulator_list(_fifo)
       , _fft_list(_fifo)
     {}
@@ -75,11 +77,7 @@ class DcaRenderer : public LoudspeakerRenderer<DcaRenderer>
     APF_PROCESS(DcaRenderer, _base)
     {
       this->_process_list(_source_list);
-      this->_process_list(_mode_pair_list);
       this->_process_list(_mode_accumulator_list);
-
-      _fft_matrix.set_channels(_mode_matrix.slices);  // transpose matrix
-
       this->_process_list(_fft_list);
     }
 
@@ -88,9 +86,13 @@ class DcaRenderer : public LoudspeakerRenderer<DcaRenderer>
     float array_radius;
 
   private:
-    matrix_t _mode_matrix;
-    fft_matrix_t _fft_matrix;
-    rtlist_t _mode_pair_list, _mode_accumulator_list, _fft_list;
+    const unsigned _planner_flag;
+    /// One channel per mode, transformed in-place to one channel per
+    /// loudspeaker
+    fft_matrix_t _mode_matrix;
+    /// Point source coefficients for each mode number
+    std::vector<DcaCoefficientTable<double>> _coefficient_tables;
+    rtlist_t _mode_accumulator_list, _fft_list;
 };
 
 class DcaRenderer::Source : public _base::Source
@@ -114,15 +116,15 @@ class DcaRenderer::Source : public _base::Source
 
       auto source_orientation = Orientation();
 
-      const std::string& model = this->model;
-      if (model == "point")
+      SourceModel model = this->model;
+      if (model == SourceModel::point)
       {
         this->source_model = coeff_t::point_source;
         source_orientation = (Position(this->position)
             - Position(this->parent.state.reference_position)).orientation();
         // TODO: Undo inherent amplitude decay
       }
-      else if (model == "plane")
+      else if (model == SourceModel::plane)
       {
         this->source_model = coeff_t::plane_wave;
         source_orientation = Orientation(this->rotation) - Orientation(180);
@@ -144,6 +146,8 @@ class DcaRenderer::Source : public _base::Source
       assert(this->distance.exactly_one_assignment());
       assert(this->angle.exactly_one_assignment());
       assert(this->source_model.exactly_one_assignment());
+
+      _process_modes();
     }
 
     apf::BlockParameter<float> distance;
@@ -151,34 +155,47 @@ class DcaRenderer::Source : public _base::Source
     apf::BlockParameter<coeff_t::source_t> source_model;
 
   private:
+    static std::vector<size_t> _lane_sections(size_t order);
+
+    void _process_modes();
+
+    // Mode objects, sorted by mode number
+    std::vector<std::unique_ptr<Mode>> _mode_storage;
     // Pointers to Mode objects for (dis-)connecting
     std::list<const Mode*> _modes;
-    // Pointers to ModePair objects for removing when Source is deleted
-    std::list<ModePair*> _mode_pairs;
+    // One filter coefficient set per mode, sorted like the lanes of _filter
+    std::vector<coeff_t> _coefficients;
+    // IIR filters of all modes, lane i belongs to mode number (order - i)
+    filter_type _filter;
 };
 
-class DcaRenderer::Mode : public ProcessItem<Mode>
-                           , public apf::fixed_vector<sample_type>
+class DcaRenderer::Mode
+  : public apf::fixed_vector<sample_type, SourceArenaAllocator<sample_type>>
 {
   public:
     Mode(size_t mode_number, const Source& s)
-      : apf::fixed_vector<sample_type>(s.parent.block_size())
+      : apf::fixed_vector<sample_type, SourceArenaAllocator<sample_type>>(
+          s.parent.block_size())
       , source(s)
       , rotation1(0)
       , rotation2(0)
       , old_rotation1(0)
       , old_rotation2(0)
       , _mode_number(mode_number)
-      , _filter(mode_number == 0 ? 1 : (mode_number + 1) / 2)  // round up
-      // Coefficients are all zeros by default
-      , _coefficients(mode_number, s.parent.sample_rate()
-          , s.parent.array_radius, ssr::c)
-      , _old_coefficients(_coefficients)
     {}
 
-    APF_PROCESS(Mode, ProcessItem<Mode>)
+    /// Update rotation factors, must be called once per block.
+    void update();
+
+    // Modes are stored next to their Source, see SourceArena
+    static void* operator new(size_t size)
+    {
+      return SourceArena::allocate(size);
+    }
+
+    static void operator delete(void* ptr)
     {
-      _process();
+      SourceArena::deallocate(ptr);
     }
 
     const Source& source;
@@ -186,71 +203,66 @@ class DcaRenderer::Mode : public ProcessItem<Mode>
     apf::CombineChannelsResult::type interpolation_mode;
 
   private:
-    void _process();
-
     sample_type _mode_number;
-    filter_type _filter;
-    coeff_t _coefficients, _old_coefficients;
 };
 
-void DcaRenderer::Mode::_process()
+/// Number of IIR sections for each mode, in order of decreasing mode number.
+std::vector<size_t>
+DcaRenderer::Source::_lane_sections(size_t order)
+{
+  auto result = std::vector<size_t>();
+  for (size_t i = 0; i <= order; ++i)
+  {
+    size_t mode_number = order - i;
+    // round up
+    result.push_back(mode_number == 0 ? 1 : (mode_number + 1) / 2);
+  }
+  return result;
+}
+
+void
+DcaRenderer::Source::_process_modes()
 {
   // IIR filtering is not done in RenderFunction because workload would be
   // distributed very un-evenly between threads!
+  // All modes of a source are filtered at once, each mode in its own lane.
 
-  if (!this->source.distance.changed() && !this->source.source_model.changed())
-  {
-    // process filter (entire block)
-    _filter.execute(this->source.begin(), this->source.end()
-        , this->begin());
-  }
-  else
+  // Plane wave coefficients don't depend on the distance
+  if (this->source_model.changed() || (this->distance.changed()
+        && this->source_model == coeff_t::point_source))
   {
-    _old_coefficients.swap(_coefficients);
-
     // Avoid focused sources (for now ...):
-    float distance = std::max(this->source.distance.get()
-        , this->source.parent.array_radius);
-
-    // scale filter coefficients
-    _coefficients.reset(distance, this->source.source_model);
-
-    apf::dual_iterator<coeff_t::iterator>
-      first_section(_old_coefficients.begin(), _coefficients.begin());
-    apf::dual_iterator<coeff_t::iterator>
-      last_section(_old_coefficients.end(), _coefficients.end());
+    float distance = std::max(this->distance.get(), this->parent.array_radius);
 
-    sample_type block_size = this->size();
-
-    auto in = this->source.begin();
-    auto out = this->begin();
-
-    // Calculate each sample separately. The first sample uses the old
-    // coefficients, after the last sample the filter is updated again for the
-    // next block.
-    for (sample_type index = 1; index <= block_size; ++index)
+    size_t order = _coefficients.size() - 1;
+    for (size_t lane = 0; lane < _coefficients.size(); ++lane)
     {
-      // Calculate one output sample
-      *out++ = _filter(*in++);
-
-      using result_type = apf::SosCoefficients<double>;
-      using argument_type = const std::pair<result_type, result_type>&;
-
-      auto interp_coeffs = [index, block_size] (argument_type coeffs)
+      auto& coefficients = _coefficients[lane];
+      // scale filter coefficients, use the table if possible
+      if (this->source_model != coeff_t::point_source
+          || !this->parent._coefficient_tables[order - lane].lookup(distance
+            , coefficients))
       {
-        return coeffs.first
-          + index * (coeffs.second - coeffs.first) / block_size;
-      };
-
-      // Set interpolated filter coefficients
-      _filter.set(apf::make_transform_iterator(first_section, interp_coeffs)
-                , apf::make_transform_iterator(last_section, interp_coeffs));
+        coefficients.reset(distance, this->source_model);
+      }
+      // The new coefficients are interpolated during the next block
+      _filter.set(lane, coefficients.begin(), coefficients.end());
     }
+  }
+
+  _filter.execute(this->begin(), this->end());
 
-    assert(in == this->source.end());
-    assert(out == this->end());
+  size_t modes = _mode_storage.size();
+  for (size_t mode_number = 0; mode_number < modes; ++mode_number)
+  {
+    Mode& mode = *_mode_storage[mode_number];
+    _filter.copy_lane(modes - 1 - mode_number, mode.begin());
+    mode.update();
   }
+}
 
+void DcaRenderer::Mode::update()
+{
   // Note: This must be done if angle OR weighting factor changes
   this->old_rotation1 = this->rotation1;
   this->old_rotation2 = this->rotation2;
@@ -283,53 +295,13 @@ void DcaRenderer::Mode::_process()
   }
 }
 
-/** Combination of two Mode%s.
- * The only reason for this class is distribution of workload. It combines two
- * Mode%s in a way that each ModePair needs a similar amount of processing
- * power.
- **/
-class DcaRenderer::ModePair : public ProcessItem<ModePair>
-{
-  public:
-    ModePair(size_t mode_number, size_t order, const Source& source)
-      : _second(order - mode_number, source)
-    {
-      bool order_is_odd = (order % 2 == 0);
-
-      if ((mode_number == 0) && order_is_odd)
-      {
-        // With an odd number of Modes, the first ModePair gets only one Mode.
-        // Therefore, _first stays empty.
-      }
-      else
-      {
-        _first.reset(new Mode(mode_number - order_is_odd, source));
-      }
-    }
-
-    APF_PROCESS(ModePair, ProcessItem<ModePair>)
-    {
-      if (_first)
-      {
-        _first->process();
-      }
-      _second.process();
-    }
-
-    const Mode* first_ptr() const { return _first.get(); }
-    const Mode* second_ptr() const { return &_second; }
-
-  private:
-    std::unique_ptr<Mode> _first;
-    Mode _second;
-};
-
 DcaRenderer::Source::Source(const Params& p)
   : _base::Source(p)
   // Set impossible values to force update in first cycle:
   , distance(-1.0f)
   , angle(std::numeric_limits<float>::infinity())
   , source_model(coeff_t::source_t(-1))
+  , _filter(_lane_sections(this->parent.order), this->parent.block_size())
 {}
 
 class DcaRenderer::RenderFunction
@@ -404,9 +376,10 @@ template<typename I1, typename I2>
 class DcaRenderer::ModeAccumulator : public ModeAccumulatorBase
 {
   public:
-    ModeAccumulator(I1 i1, I2 i2, size_t block_size)
+    ModeAccumulator(I1 i1, I2 i2, size_t block_size, const StageTimer& timer)
       : _output_channels(i1, i2, block_size)
       , _combiner(mode_pointers, _output_channels)
+      , _timer(timer)
     {}
 
     // APF_PROCESS doesn't work here because ModeAccumulatorBase cannot be a
@@ -416,6 +389,7 @@ class DcaRenderer::ModeAccumulator : public ModeAccumulatorBase
     {
       // TODO: global scale factor (depends only on array size)?
 
+      StageTimer::Scope timer(_timer, StageTimer::combine);
       _combiner.process(RenderFunction());
     }
 
@@ -443,14 +417,16 @@ class DcaRenderer::ModeAccumulator : public ModeAccumulatorBase
 
     apf::CombineChannelsInterpolation<apf::cast_proxy_const<Mode, mode_ptrs_t>
       , two_matrix_channels> _combiner;
+    const StageTimer& _timer;
 };
 
 /// Helper function for automatic template type deduction
 template<typename I1, typename I2>
 DcaRenderer::ModeAccumulator<I1, I2>*
-new_mode_accumulator(I1 i1, I2 i2, size_t block_size)
+new_mode_accumulator(I1 i1, I2 i2, size_t block_size
+    , const StageTimer& timer)
 {
-  return new DcaRenderer::ModeAccumulator<I1, I2>(i1, i2, block_size);
+  return new DcaRenderer::ModeAccumulator<I1, I2>(i1, i2, block_size, timer);
 }
 
 void
@@ -458,27 +434,21 @@ DcaRenderer::Source::connect()
 {
   size_t order = this->parent.order;
 
-  // create ModePair objects
+  // create Mode objects and filter coefficients
 
-  for (size_t mode_number = 0; mode_number <= order / 2; ++mode_number)
+  for (size_t mode_number = 0; mode_number <= order; ++mode_number)
   {
-    _mode_pairs.push_back(new ModePair(mode_number, order, *this));
+    _mode_storage.emplace_back(new Mode(mode_number, *this));
+    _modes.push_back(_mode_storage.back().get());
   }
 
-  // create list of pointers to Mode objects
-
-  auto reverse_pairs
-    = apf::make_begin_and_end(_mode_pairs.rbegin(), _mode_pairs.rend());
-  for (auto pair: reverse_pairs)
+  for (size_t lane = 0; lane <= order; ++lane)
   {
-    if (pair->first_ptr()) _modes.push_front(pair->first_ptr());
-    _modes.push_back(pair->second_ptr());
+    // Coefficients are all zeros by default
+    _coefficients.emplace_back(order - lane, this->parent.sample_rate()
+        , this->parent.array_radius, ssr::c);
   }
 
-  // add _mode_pairs to _mode_pair_list
-
-  this->parent._mode_pair_list.add(_mode_pairs.begin(), _mode_pairs.end());
-
   // connect modes with ModeAccumulator
 
   this->parent.add_to_sublist(_modes
@@ -497,19 +467,54 @@ DcaRenderer::Source::disconnect()
         this->parent._mode_accumulator_list)
       , &ModeAccumulatorBase::mode_pointers);
 
-  // The objects are actually deleted here (via the _fifo):
-  this->parent._mode_pair_list.rem(_mode_pairs.begin(), _mode_pairs.end());
+  // Note: The Mode objects are deleted together with the Source (via the
+  // _fifo), because they might still be used by the ModeAccumulators.
 
   _modes.clear();
-  _mode_pairs.clear();
 }
 
+namespace internal
+{
+
+// Batched real-to-real plans are not provided by apf::fftw
+
+inline fftwf_plan
+plan_many_r2r(int n, int howmany, float* data, int stride
+    , fftw_r2r_kind kind, unsigned flags)
+{
+  return fftwf_plan_many_r2r(1, &n, howmany, data, nullptr, stride, 1
+      , data, nullptr, stride, 1, &kind, flags);
+}
+
+inline fftw_plan
+plan_many_r2r(int n, int howmany, double* data, int stride
+    , fftw_r2r_kind kind, unsigned flags)
+{
+  return fftw_plan_many_r2r(1, &n, howmany, data, nullptr, stride, 1
+      , data, nullptr, stride, 1, &kind, flags);
+}
+
+}  // namespace internal
+
+/** In-place inverse FFT across all channels of a matrix.
+ * One transform is done for each sample index, all of them with a single
+ * batched FFTW plan.  The elements of one transform are one channel apart
+ * (i.e. the stride is the block size), consecutive transforms are adjacent.
+ * Therefore, no transposition of the matrix is needed.
+ **/
 class DcaRenderer::FftProcessor : public ProcessItem<FftProcessor>
 {
   public:
-    FftProcessor(size_t block_size, sample_type* first)
-      : _fft_plan(apf::fftw<sample_type>::plan_r2r_1d, block_size, first, first
-            , FFTW_HC2R, FFTW_PATIENT)
+    FftProcessor(size_t channels, size_t block_size, sample_type* first
+        , unsigned planner_flag)
+      : _fft_plan([] (int n, int howmany, sample_type* data, int stride
+            , unsigned flags)
+          {
+            return internal::plan_many_r2r(n, howmany, data, stride
+                , FFTW_HC2R, flags);
+          }
+          , int(channels), int(block_size), first, int(block_size)
+          , planner_flag)
     {}
 
     APF_PROCESS(FftProcessor, ProcessItem<FftProcessor>)
@@ -528,10 +533,11 @@ struct DcaRenderer::Output : _base::Output
 
   APF_PROCESS(Output, _base::Output)
   {
-    std::copy(this->slice.begin(), this->slice.end(), this->buffer.begin());
+    std::copy(this->channel.begin(), this->channel.end()
+        , this->buffer.begin());
   }
 
-  fft_matrix_t::Slice slice;
+  fft_matrix_t::Channel channel;
 };
 
 void
@@ -569,10 +575,16 @@ DcaRenderer::load_reproduction_setup()
     "Assuming circular (counterclockwise) setup!\n" << std::endl;
 
   _mode_matrix.initialize(normal_loudspeakers, this->block_size());
-  _fft_matrix.initialize(this->block_size(), normal_loudspeakers);
 
   this->order = normal_loudspeakers / 2;  // round down
 
+  _coefficient_tables.clear();
+  for (size_t mode_number = 0; mode_number <= this->order; ++mode_number)
+  {
+    _coefficient_tables.emplace_back(mode_number, this->sample_rate()
+        , this->array_radius, ssr::c);
+  }
+
   for (size_t i = 0; i <= this->order; ++i)
   {
     if (i == 0 || (i == this->order && normal_loudspeakers % 2 == 0))
@@ -580,35 +592,31 @@ DcaRenderer::load_reproduction_setup()
       _mode_accumulator_list.add(new_mode_accumulator(
             _mode_matrix.channels[i].begin()
             , apf::discard_iterator()
-            , this->block_size()));
+            , this->block_size(), this->_stage_timer));
     }
     else
     {
       _mode_accumulator_list.add(new_mode_accumulator(
             _mode_matrix.channels[i].begin()
             , _mode_matrix.channels[normal_loudspeakers - i].begin()
-            , this->block_size()));
+            , this->block_size(), this->_stage_timer));
     }
 
     // TODO: documentation, mention half-complex format of FFTW
   }
 
-  for (fft_matrix_t::channels_iterator ch = _fft_matrix.channels.begin()
-      ; ch != _fft_matrix.channels.end()
-      ; ++ch)
-  {
-    _fft_list.add(new FftProcessor(normal_loudspeakers, ch->begin()));
-  }
+  _fft_list.add(new FftProcessor(normal_loudspeakers, this->block_size()
+        , _mode_matrix.channels.begin()->begin(), _planner_flag));
 
-  assert(outputs.size() == size_t(std::distance(_fft_matrix.slices.begin()
-                                              , _fft_matrix.slices.end())));
+  assert(outputs.size() == size_t(std::distance(_mode_matrix.channels.begin()
+                                              , _mode_matrix.channels.end())));
 
-  fft_matrix_t::slices_iterator slice = _fft_matrix.slices.begin();
+  fft_matrix_t::channels_iterator channel = _mode_matrix.channels.begin();
   for (output_list_t::iterator out = outputs.begin()
       ; out != outputs.end()
       ; ++out)
   {
-    out->slice = *slice++;
+    out->channel = *channel++;
   }
 }
 
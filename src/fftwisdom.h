@@ -0,0 +1,115 @@
+/******************************************************************************
+ * Copyright © 2019 SSR Contributors                                          *
+ *                                                                            *
+ * This file is part of the SoundScape Renderer (SSR).                        *
+ *                                                                            *
+ * The SSR is free software:  you can redistribute it and/or modify it  under *
+ * the terms of the  GNU  General  Public  License  as published by the  Free *
+ * Software Foundation, either version 3 of the License,  or (at your option) *
+ * any later version.                                                         *
+ *                                                                            *
+ * The SSR is distributed in the hope that it will be useful, but WITHOUT ANY *
+ * WARRANTY;  without even the implied warranty of MERCHANTABILITY or FITNESS *
+ * FOR A PARTICULAR PURPOSE.                                                  *
+ * See the GNU General Public License for more details.                       *
+ *                                                                            *
+ * You should  have received a copy  of the GNU General Public License  along *
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                            *
+ * The SSR is a tool  for  real-time  spatial audio reproduction  providing a *
+ * variety of rendering algorithms.                                           *
+ *                                                                            *
+ * http://spatialaudio.net/ssr                           ssr@spatialaudio.net *
+ ******************************************************************************/
+
+/// @file
+/// Loading and saving of FFTW wisdom, selection of FFTW planner effort.
+
+#ifndef SSR_FFTWISDOM_H
+#define SSR_FFTWISDOM_H
+
+#include <stdexcept>  // for std::invalid_argument
+#include <string>
+
+#include <fftw3.h>
+
+#include "ssr_global.h"  // for SSR_VERBOSE(), SSR_WARNING()
+
+namespace ssr
+{
+
+/// Convert a planner effort name to the according FFTW planner flag.
+/// @param effort "estimate", "measure", "patient" or "exhaustive"
+/// @throw std::invalid_argument for unknown names
+inline unsigned fftw_planner_flag(const std::string& effort)
+{
+  if (effort == "estimate") return FFTW_ESTIMATE;
+  if (effort == "measure") return FFTW_MEASURE;
+  if (effort == "patient") return FFTW_PATIENT;
+  if (effort == "exhaustive") return FFTW_EXHAUSTIVE;
+  throw std::invalid_argument("Unknown FFTW planner effort: \"" + effort
+      + "\" (possible values: estimate, measure, patient, exhaustive)");
+}
+
+/** FFTW wisdom, stored in a file.
+ * The wisdom is loaded in the constructor, afterwards all FFTW plans with a
+ * size that is found in the wisdom can be created without measurements.
+ * It is written back to the file in the destructor, including all plans which
+ * were created in the meantime.
+ *
+ * All audio processing in the SSR uses single precision, therefore only the
+ * wisdom of the @c fftwf_* functions is handled.
+ **/
+class FftWisdom
+{
+  public:
+    /// Constructor.
+    /// @param file_name wisdom file, if empty, nothing is loaded or saved.
+    explicit FftWisdom(const std::string& file_name)
+      : _file_name(file_name)
+    {
+      if (_file_name == "") return;
+
+      if (fftwf_import_wisdom_from_filename(_file_name.c_str()))
+      {
+        SSR_VERBOSE("Loaded FFTW wisdom from \"" << _file_name << "\".");
+      }
+      else
+      {
+        // This is expected for the first run
+        SSR_VERBOSE("No FFTW wisdom loaded from \"" << _file_name << "\".");
+      }
+    }
+
+    ~FftWisdom()
+    {
+      this->save();
+    }
+
+    FftWisdom(const FftWisdom&) = delete;
+    FftWisdom& operator=(const FftWisdom&) = delete;
+
+    /// Save all accumulated wisdom.
+    /// @return @b true on success (or if there is no file name)
+    bool save() const
+    {
+      if (_file_name == "") return true;
+
+      if (!fftwf_export_wisdom_to_filename(_file_name.c_str()))
+      {
+        SSR_WARNING("Unable to save FFTW wisdom to \"" << _file_name << "\"!");
+        return false;
+      }
+      SSR_VERBOSE("Saved FFTW wisdom to \"" << _file_name << "\".");
+      return true;
+    }
+
+    const std::string& file_name() const { return _file_name; }
+
+  private:
+    const std::string _file_name;
+};
+
+}  // namespace ssr
+
+#endif
@@ -55,6 +55,7 @@ class Subscriber final : public api::BundleEvents
                        , public api::MasterMetering
                        , public api::OutputActivity
                        , public api::CpuLoad
+                       , public api::DspTiming
 {
 public:
   explicit Subscriber(Connection& connection, api::Publisher& controller)
@@ -127,6 +128,11 @@ public:
       _sub_cpu_load.reset();
       _sub_cpu_load = _controller.subscribe()->cpu_load(this);
     }
+    else if (name == "dsp-timing")
+    {
+      _sub_dsp_timing.reset();
+      _sub_dsp_timing = _controller.subscribe()->dsp_timing(this);
+    }
     else
     {
       SSR_ERROR("Unknown subscription: \"" << name << "\"");
@@ -181,6 +187,10 @@ public:
     {
       _sub_cpu_load.reset();
     }
+    else if (name == "dsp-timing")
+    {
+      _sub_dsp_timing.reset();
+    }
     else
     {
       SSR_ERROR("Unknown subscription: \"" << name << "\"");
@@ -466,6 +476,25 @@ private:
     _append("cpu-load {:.2f};\n", load);
   }
 
+  // DspTiming
+
+  void stage_load(const std::string& stage, float* begin, float* end) override
+  {
+    _append("dsp-timing {}", stage);
+    for (auto* ptr = begin; ptr != end; ++ptr)
+    {
+      _append(" {:.2f}", *ptr);
+    }
+    _append(";\n");
+  }
+
+  void parameter_updates(size_t received, size_t coalesced, size_t applied
+      , size_t pending) override
+  {
+    _append("parameter-updates {} {} {} {};\n"
+        , received, coalesced, applied, pending);
+  }
+
   Connection& _connection;
   api::Publisher& _controller;
   std::shared_ptr<buffer_t> _buffer;
@@ -482,6 +511,7 @@ private:
   std::unique_ptr<api::Subscription> _sub_master_metering;
   std::unique_ptr<api::Subscription> _sub_output_activity;
   std::unique_ptr<api::Subscription> _sub_cpu_load;
+  std::unique_ptr<api::Subscription> _sub_dsp_timing;
 };
 
 }  // namespace fudi
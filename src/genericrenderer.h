@@ -48,6 +48,9 @@ class GenericRenderer : public SourceToOutput<GenericRenderer
   public:
     static const char* name() { return "GenericRenderer"; }
 
+    /// The distance attenuation is part of the impulse responses
+    static constexpr bool distance_attenuation = false;
+
     using Input = _base::DefaultInput;
     class Source;
     struct SourceChannel;
@@ -199,6 +202,7 @@ class GenericRenderer::Output : public _base::Output
 
     APF_PROCESS(Output, _base::Output)
     {
+      StageTimer::Scope timer(this->parent._stage_timer, StageTimer::combine);
       _combiner.process(RenderFunction());
     }
 
@@ -0,0 +1,254 @@
+/******************************************************************************
+ * Copyright © 2019 SSR Contributors                                          *
+ *                                                                            *
+ * This file is part of the SoundScape Renderer (SSR).                        *
+ *                                                                            *
+ * The SSR is free software:  you can redistribute it and/or modify it  under *
+ * the terms of the  GNU  General  Public  License  as published by the  Free *
+ * Software Foundation, either version 3 of the License,  or (at your option) *
+ * any later version.                                                         *
+ *                                                                            *
+ * The SSR is distributed in the hope that it will be useful, but WITHOUT ANY *
+ * WARRANTY;  without even the implied warranty of MERCHANTABILITY or FITNESS *
+ * FOR A PARTICULAR PURPOSE.                                                  *
+ * See the GNU General Public License for more details.                       *
+ *                                                                            *
+ * You should  have received a copy  of the GNU General Public License  along *
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                            *
+ * The SSR is a tool  for  real-time  spatial audio reproduction  providing a *
+ * variety of rendering algorithms.                                           *
+ *                                                                            *
+ * http://spatialaudio.net/ssr                           ssr@spatialaudio.net *
+ ******************************************************************************/
+
+/// @file
+/// Three-dimensional Higher-Order Ambisonics renderer.
+
+#ifndef SSR_HOARENDERER_H
+#define SSR_HOARENDERER_H
+
+#include <cmath>  // for std::sqrt()
+
+#include "ssr_global.h"
+#include "ambisonicsrenderer.h"
+#include "ambisonicstools.h"  // for SphericalHarmonics, allrad_decoder()
+#include "geometry.h"  // for vec3, quat
+
+namespace ssr
+{
+
+/** Higher-Order Ambisonics Renderer.
+ * Sources are encoded into (N+1)^2 real spherical harmonics (ACN channel
+ * order, N3D normalization), N being the Ambisonics order.
+ * The harmonic channels are decoded to the loudspeakers with an AllRAD
+ * decoding matrix, computed once when the reproduction setup is loaded:
+ * A dense, nearly uniform set of virtual loudspeakers is decoded with a
+ * sampling decoder and then panned to the real loudspeakers with 3D VBAP.
+ * See Franz Zotter and Matthias Frank, "All-Round Ambisonic Panning and
+ * Decoding", Journal of the Audio Engineering Society (JAES), Vol.60(10),
+ * October 2012.
+ **/
+class HoaRenderer : public AmbisonicsRenderer<HoaRenderer>
+{
+  private:
+    using _base = AmbisonicsRenderer<HoaRenderer>;
+
+  public:
+    static const char* name() { return "HOA-Renderer"; }
+
+    class Source;
+    using Output = _base::Output;
+
+    explicit HoaRenderer(const apf::parameter_map& params)
+      : _base(params)
+      , _order(params.get("ambisonics_order", 0))
+      , _max_re(params.get("hoa_max_re", true))
+      , _reference_position(this->state.reference_position.get())
+      , _reference_rotation(this->state.reference_rotation.get())
+      , _inverse_reference_rotation(gml::conj(quat(_reference_rotation)))
+      , _reference_changed(false)
+    {
+      SSR_VERBOSE((_max_re ? "U" : "Not u") << "sing max-rE weighting.");
+    }
+
+    APF_PROCESS(HoaRenderer, _base)
+    {
+      _update_reference();
+      this->_process_list(_source_list);  // encoding gains
+      this->_process_list(_harmonic_list);  // encoding
+      // decoding is done in the outputs
+    }
+
+    void load_reproduction_setup();
+
+  private:
+    void _update_reference();
+
+    int _order;
+    bool _max_re;
+
+    SphericalHarmonics _spherical_harmonics;  // N3D, in ACN order
+
+    // The reference is checked once per block, sources only re-calculate
+    // their encoding gains if the reference (or the source) has moved.
+    Pos _reference_position;
+    Rot _reference_rotation;
+    quat _inverse_reference_rotation;
+    bool _reference_changed;
+};
+
+void
+HoaRenderer::_update_reference()
+{
+  const Pos& position = this->state.reference_position.get();
+  const Rot& rotation = this->state.reference_rotation.get();
+
+  _reference_changed = position.x != _reference_position.x
+    || position.y != _reference_position.y
+    || position.z != _reference_position.z
+    || rotation.x != _reference_rotation.x
+    || rotation.y != _reference_rotation.y
+    || rotation.z != _reference_rotation.z
+    || rotation.w != _reference_rotation.w;
+
+  if (_reference_changed)
+  {
+    _reference_position = position;
+    _reference_rotation = rotation;
+    _inverse_reference_rotation = gml::conj(quat(rotation));
+  }
+}
+
+class HoaRenderer::Source : public _base::Source
+{
+  public:
+    Source(const Params& p)
+      : _base::Source(p)
+    {}
+
+    /// Encoding gains: spherical harmonics (in ACN order) times the
+    /// weighting factor
+    APF_PROCESS(Source, _base::Source)
+    {
+      const Pos& position = this->position.get();
+
+      bool direction_changed = !_unit_gains_valid
+        || this->parent._reference_changed
+        || position.x != _position.x
+        || position.y != _position.y
+        || position.z != _position.z;
+
+      if (direction_changed)
+      {
+        _position = position;
+        _update_unit_gains();
+      }
+
+      _update_gains(direction_changed);
+    }
+
+  private:
+    void _update_unit_gains()
+    {
+      // NB: The reference offset is ignored.
+
+      const auto& parent = this->parent;
+      auto direction = vec3(gml::transform(parent._inverse_reference_rotation
+            , vec3(_position) - vec3(parent._reference_position)));
+
+      // The loudspeaker directions are given in the (legacy) coordinate
+      // system of the reproduction setup, which is rotated by 90 degrees.
+      direction = vec3{direction[1], -direction[0], direction[2]};
+
+      parent._spherical_harmonics(direction, _unit_gains.begin());
+      _unit_gains_valid = true;
+    }
+
+    Pos _position;
+};
+
+void
+HoaRenderer::load_reproduction_setup()
+{
+  // TODO: find a way to avoid overwriting load_reproduction_setup()
+
+  _base::load_reproduction_setup();
+
+  // TODO: get loudspeaker delays from setup?
+
+  auto loudspeakers = std::vector<const Output*>();
+  auto directions = std::vector<vec3>();
+
+  for (const auto& out: rtlist_proxy<Output>(this->get_output_list()))
+  {
+    if (out.model == LegacyLoudspeaker::subwoofer)
+    {
+      // subwoofers are handled below
+    }
+    else  // loudspeaker type == normal
+    {
+      auto direction = vec3{out.position.x, out.position.y, out.height};
+      auto length = gml::length(direction);
+      if (length < 0.0001f)
+      {
+        throw std::logic_error("HOA: Loudspeaker at the origin!");
+      }
+      loudspeakers.push_back(&out);
+      directions.push_back(direction / length);
+    }
+  }
+
+  if (loudspeakers.size() < 1)
+  {
+    throw std::logic_error("No loudspeakers found!");
+  }
+
+  if (!_order)
+  {
+    _order = std::max(1
+        , int(std::sqrt(static_cast<double>(loudspeakers.size()))) - 1);
+  }
+
+  assert(_order > 0);
+
+  SSR_VERBOSE("Using Ambisonics order " << _order << ".");
+
+  _harmonics = (_order + 1) * (_order + 1);
+
+  _spherical_harmonics = SphericalHarmonics(_order);
+
+  auto modal_weights = _max_re ? max_re_weights(_order)
+    : std::vector<double>(_order + 1, 1.0);
+
+  auto [decoder, triangles, virtual_loudspeakers]
+    = allrad_decoder(directions, _spherical_harmonics, modal_weights);
+
+  _decoder.assign(this->get_output_list().size() * _harmonics, 0);
+
+  for (size_t l = 0; l < loudspeakers.size(); ++l)
+  {
+    std::copy(decoder.begin() + l * _harmonics
+        , decoder.begin() + (l + 1) * _harmonics
+        , _decoder.begin() + loudspeakers[l]->index * _harmonics);
+  }
+
+  for (const auto& out: rtlist_proxy<Output>(this->get_output_list()))
+  {
+    if (out.model == LegacyLoudspeaker::subwoofer)
+    {
+      // omnidirectional component (which is 1 in N3D)
+      _decoder[out.index * _harmonics] = 1;
+    }
+  }
+
+  SSR_VERBOSE("HOA: AllRAD decoder with " << triangles
+      << " loudspeaker triangles and " << virtual_loudspeakers
+      << " virtual loudspeakers.");
+
+  _add_harmonic_channels();
+}
+
+}  // namespace ssr
+
+#endif
@@ -49,18 +49,56 @@ class LoudspeakerRenderer : public RendererBase<Derived>
     class Output : public _base::Output, public LegacyLoudspeaker
     {
       public:
-        struct Params : _base::Output::Params, LegacyLoudspeaker {};
+        struct Params : _base::Output::Params, LegacyLoudspeaker
+        {
+          size_t index = 0;
+          float height = 0.0f;
+        };
 
         // TODO: handle loudspeaker delays?
 
-        Output(const Params& p) : _base::Output(p), LegacyLoudspeaker(p) {}
+        Output(const Params& p)
+          : _base::Output(p)
+          , LegacyLoudspeaker(p)
+          , index(p.index)
+          , height(p.height)
+        {}
+
+        /// Position in the output list (and in LoudspeakerGeometry)
+        const size_t index;
+        /// z coordinate (in meters), only used by 3D renderers
+        const float height;
     };
 
+    /** Loudspeaker positions and orientations after applying the reference.
+     * All vectors are indexed by Output::index.
+     * This is updated once per block (only if the reference has changed)
+     * and may only be accessed in the realtime thread.
+     **/
+    struct LoudspeakerGeometry
+    {
+      /// Reference including the (currently broken) offset, cf. WFS renderer
+      DirectionalPoint reference;
+      /// Loudspeaker positions, transformed by the reference (without offset)
+      std::vector<Position> positions;
+      /// Loudspeaker orientations, transformed by the reference
+      std::vector<Orientation> orientations;
+      /// Distance between each (transformed) loudspeaker and #reference
+      std::vector<float> reference_distances;
+      /// Azimuths (radians) in array coordinates, seen from the origin
+      std::vector<float> array_angles;
+      /// Azimuths (radians, 0 ... 2pi), seen from the reference offset
+      std::vector<float> offset_angles;
+    };
+
+    struct Process;
+
     LoudspeakerRenderer(const apf::parameter_map& p)
       : _base(p)
       , _reproduction_setup(p.get("reproduction_setup", ""))
       , _xml_schema(p.get("xml_schema", ""))
       , _next_loudspeaker_channel(1)
+      , _loudspeaker_count(0)
     {
       this->_show_head = false;
     }
@@ -69,13 +107,23 @@ class LoudspeakerRenderer : public RendererBase<Derived>
 
     void get_loudspeakers(std::vector<LegacyLoudspeaker>& l) const;
 
+    const LoudspeakerGeometry& loudspeaker_geometry() const
+    {
+      return _geometry;
+    }
+
+  protected:
+    void _update_loudspeaker_geometry(bool force = false);
+
   private:
     void _load_loudspeaker(const Node& node);
     void _load_linear_array(const Node& node);
     void _load_circular_array(const Node& node);
     void _set_connection(apf::parameter_map& p);
+    void _add_loudspeaker(typename Output::Params& p);
 
     std::unique_ptr<Position> _get_position(const Node& node);
+    float _get_height(const Node& node);
     std::unique_ptr<Orientation> _get_orientation(const Node& node);
     std::unique_ptr<Orientation> _get_angle(const Node& node);
 
@@ -83,8 +131,77 @@ class LoudspeakerRenderer : public RendererBase<Derived>
     const std::string _xml_schema;
 
     int _next_loudspeaker_channel;
+    size_t _loudspeaker_count;
+
+    LoudspeakerGeometry _geometry;
+    DirectionalPoint _old_reference, _old_reference_offset;
 };
 
+/// Update the loudspeaker geometry before the Derived renderer is processed.
+// NB: The APF_PROCESS macro doesn't work here because of the use of CRTP.
+template<typename Derived>
+struct LoudspeakerRenderer<Derived>::Process : _base::Process
+{
+  Process(Derived& parent)
+    : _base::Process(parent)
+  {
+    parent._update_loudspeaker_geometry();
+  }
+};
+
+/** Re-calculate LoudspeakerGeometry if the reference has changed.
+ * @param force re-calculate even if the reference hasn't changed
+ **/
+template<typename Derived>
+void
+LoudspeakerRenderer<Derived>::_update_loudspeaker_geometry(bool force)
+{
+  auto ref = DirectionalPoint(Position(this->state.reference_position)
+      , Orientation(this->state.reference_rotation));
+  auto offset = DirectionalPoint(
+      Position(this->state.reference_position_offset)
+      , Orientation(this->state.reference_rotation_offset));
+
+  if (!force
+      && ref.position == _old_reference.position
+      && ref.orientation.azimuth == _old_reference.orientation.azimuth
+      && offset.position == _old_reference_offset.position
+      && offset.orientation.azimuth == _old_reference_offset.orientation.azimuth)
+  {
+    return;
+  }
+  _old_reference = ref;
+  _old_reference_offset = offset;
+
+  // TODO: this is actually wrong!
+  // We use it to be compatible with the (also wrong) GUI implementation.
+  _geometry.reference = ref;
+  _geometry.reference.transform(DirectionalPoint(offset.position
+        , offset.orientation - Orientation(90)));
+
+  // WARNING: The reference offset is currently broken!
+  // To make it work, we have to fiddle a bit (cf. VBAP renderer).
+  auto rotated_offset = offset.position;
+  rotated_offset.rotate(-90.0);
+
+  using out_list_t = typename _base::template rtlist_proxy<Output>;
+
+  for (const auto& out: out_list_t(this->get_output_list()))
+  {
+    auto ls = DirectionalPoint(out);
+    ls.transform(ref);
+
+    auto i = out.index;
+    assert(i < _geometry.positions.size());
+    _geometry.positions[i] = ls.position;
+    _geometry.orientations[i] = ls.orientation;
+    _geometry.reference_distances[i]
+      = (ls.position - _geometry.reference.position).length();
+    _geometry.offset_angles[i] = apf::math::wrap_two_pi(apf::math::deg2rad(
+          (out.position - rotated_offset).orientation().azimuth));
+  }
+}
+
 template<typename Derived>
 void
 LoudspeakerRenderer<Derived>::get_loudspeakers(std::vector<LegacyLoudspeaker>& l)
@@ -181,6 +298,23 @@ LoudspeakerRenderer<Derived>::load_reproduction_setup()
 
   //SSR_VERBOSE("Loaded " << l.size() << " loudspeakers from '"
   //    << setup_file_name << "'.");
+
+  // NB: The renderer is not running yet, the output list can be accessed
+  _geometry.positions.resize(_loudspeaker_count);
+  _geometry.orientations.resize(_loudspeaker_count);
+  _geometry.reference_distances.resize(_loudspeaker_count);
+  _geometry.array_angles.resize(_loudspeaker_count);
+  _geometry.offset_angles.resize(_loudspeaker_count);
+
+  using out_list_t = typename _base::template rtlist_proxy<Output>;
+
+  for (const auto& out: out_list_t(this->get_output_list()))
+  {
+    _geometry.array_angles[out.index]
+      = apf::math::deg2rad(out.position.orientation().azimuth);
+  }
+
+  _update_loudspeaker_geometry(true);
 }
 
 template<typename Derived>
@@ -195,6 +329,15 @@ LoudspeakerRenderer<Derived>::_set_connection(apf::parameter_map& p)
   ++_next_loudspeaker_channel;
 }
 
+template<typename Derived>
+void
+LoudspeakerRenderer<Derived>::_add_loudspeaker(typename Output::Params& p)
+{
+  p.index = _loudspeaker_count++;
+  _set_connection(p);
+  this->add(p);
+}
+
 template<typename Derived>
 void
 LoudspeakerRenderer<Derived>::_load_loudspeaker(const Node& node)
@@ -241,12 +384,12 @@ LoudspeakerRenderer<Derived>::_load_loudspeaker(const Node& node)
 
   typename Output::Params params;
   params.position = *position;
+  params.height = _get_height(node);
   params.orientation = *orientation;
   params.model = model;
   params.weight = weight;
   params.delay = delay;
-  _set_connection(params);
-  this->add(params);
+  _add_loudspeaker(params);
 }
 
 template<typename Derived>
@@ -334,8 +477,7 @@ LoudspeakerRenderer<Derived>::_load_linear_array(const Node& node)
     typename Output::Params params;
     params.position = current.position;
     params.orientation = current.orientation;
-    _set_connection(params);
-    this->add(params);
+    _add_loudspeaker(params);
 
     current += increment;
   }
@@ -413,8 +555,7 @@ LoudspeakerRenderer<Derived>::_load_circular_array(const Node& node)
     typename Output::Params params;
     params.position = point.position;
     params.orientation = point.orientation;
-    _set_connection(params);
-    this->add(params);
+    _add_loudspeaker(params);
   }
 }
 
@@ -449,6 +590,23 @@ LoudspeakerRenderer<Derived>::_get_position(const Node& node)
   return temp; // return NULL
 }
 
+/// Get the (optional) z coordinate of the <position> element, 0 if missing.
+template<typename Derived>
+float
+LoudspeakerRenderer<Derived>::_get_height(const Node& node)
+{
+  if (!node) return 0.0f;
+
+  for (Node i = node.child(); !!i; ++i)
+  {
+    if (i == "position")
+    {
+      return apf::str::S2RV(i.get_attribute("z"), 0.0f);
+    }
+  }
+  return 0.0f;
+}
+
 template<typename Derived>
 std::unique_ptr<Orientation>
 LoudspeakerRenderer<Derived>::_get_orientation(const Node& node)
@@ -0,0 +1,224 @@
+/******************************************************************************
+ * Copyright © 2019 SSR Contributors                                          *
+ *                                                                            *
+ * This file is part of the SoundScape Renderer (SSR).                        *
+ *                                                                            *
+ * The SSR is free software:  you can redistribute it and/or modify it  under *
+ * the terms of the  GNU  General  Public  License  as published by the  Free *
+ * Software Foundation, either version 3 of the License,  or (at your option) *
+ * any later version.                                                         *
+ *                                                                            *
+ * The SSR is distributed in the hope that it will be useful, but WITHOUT ANY *
+ * WARRANTY;  without even the implied warranty of MERCHANTABILITY or FITNESS *
+ * FOR A PARTICULAR PURPOSE.                                                  *
+ * See the GNU General Public License for more details.                       *
+ *                                                                            *
+ * You should  have received a copy  of the GNU General Public License  along *
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                            *
+ * The SSR is a tool  for  real-time  spatial audio reproduction  providing a *
+ * variety of rendering algorithms.                                           *
+ *                                                                            *
+ * http://spatialaudio.net/ssr                           ssr@spatialaudio.net *
+ ******************************************************************************/
+
+/// @file
+/// Locking of all memory and huge pages for large DSP allocations.
+
+#ifndef SSR_MEMORYLOCK_H
+#define SSR_MEMORYLOCK_H
+
+#include <cstdint>  // for uintptr_t
+#include <cstring>  // for std::strerror()
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#ifdef __linux__
+#include <cerrno>
+#include <sys/mman.h>  // for mlockall(), madvise()
+#include <sys/resource.h>  // for getrlimit()
+#endif
+
+#include "ssr_global.h"  // for SSR_VERBOSE(), SSR_WARNING()
+
+namespace ssr
+{
+
+/** Keep the memory of the SSR in RAM.
+ * With @p lock, all current and future memory is locked with mlockall().
+ * This also prefaults each new mapping when it is created, i.e. in the
+ * thread which allocates it (the control thread creates filters, delay lines
+ * etc.) instead of on first access in an audio thread.
+ * NB: This includes the whole stack of each thread.
+ * If the limit for locked memory is too small, later allocations fail,
+ * therefore check_limit() warns up front.
+ *
+ * With @p huge_pages, large anonymous mappings (large filter sets, heap) are
+ * marked for transparent huge pages, which reduces TLB misses.  The memory
+ * allocated in the meantime is covered by calling advise_huge_pages() again,
+ * but only until the renderer is activated.  Afterwards, only dedicated DSP
+ * memory uses huge pages (see SourceArena).
+ **/
+class MemoryLock
+{
+  public:
+    /// Mappings smaller than this are not considered for huge pages
+    static constexpr size_t huge_page_threshold = 2 * 1024 * 1024;
+
+    /// Rough estimate for memory allocated after check_limit() was called
+    /// (sources, delay lines, network buffers, ...)
+    static constexpr size_t headroom = 64 * 1024 * 1024;
+
+    /// @param threads Number of threads which are created later (their stacks
+    ///   are locked as well)
+    MemoryLock(bool lock, bool huge_pages, size_t threads)
+      : _huge_pages(huge_pages)
+    {
+      if (!lock && !huge_pages) return;
+#ifdef __linux__
+      if (lock)
+      {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0)
+        {
+          _locked = true;
+          SSR_VERBOSE("Memory is locked and prefaulted.");
+          this->check_limit(threads);
+        }
+        else
+        {
+          SSR_WARNING("Unable to lock memory: " << std::strerror(errno)
+              << " (check \"ulimit -l\")");
+        }
+      }
+      this->advise_huge_pages();
+#else
+      SSR_WARNING("Locking memory and huge pages are only supported on Linux!");
+#endif
+    }
+
+    ~MemoryLock()
+    {
+#ifdef __linux__
+      if (_locked) munlockall();
+#endif
+    }
+
+    MemoryLock(const MemoryLock&) = delete;
+    MemoryLock& operator=(const MemoryLock&) = delete;
+
+    /// Warn if the limit for locked memory (see "ulimit -l") is smaller
+    /// than the memory locked so far, plus the stacks of @p threads threads
+    /// which are created later, plus some headroom.
+    void check_limit(size_t threads) const
+    {
+#ifdef __linux__
+      if (!_locked) return;
+      // CAP_IPC_LOCK (e.g. root) isn't subject to the limit
+      auto capabilities = _status_field("CapEff:");
+      if (!capabilities.empty()
+          && (std::stoull(capabilities, nullptr, 16) >> 14) & 1) return;
+      rlimit limit;
+      if (getrlimit(RLIMIT_MEMLOCK, &limit) != 0
+          || limit.rlim_cur == RLIM_INFINITY) return;
+
+      // The default stack size of new threads is the stack limit
+      size_t stack_size = 8 * 1024 * 1024;
+      rlimit stack;
+      if (getrlimit(RLIMIT_STACK, &stack) == 0
+          && stack.rlim_cur != RLIM_INFINITY)
+      {
+        stack_size = stack.rlim_cur;
+      }
+
+      // Locked memory in kB
+      auto locked = std::stoull("0" + _status_field("VmLck:")) * 1024;
+      auto expected = locked + threads * stack_size + headroom;
+      if (limit.rlim_cur < expected)
+      {
+        SSR_WARNING("The limit for locked memory (" << (limit.rlim_cur >> 20)
+            << " MiB) is probably too small, about " << (expected >> 20)
+            << " MiB are needed.  Allocations will fail once the limit is "
+            "reached (check \"ulimit -l\")!");
+      }
+#endif
+    }
+
+    /// Mark large anonymous mappings for huge pages (if enabled).
+    /// This should be called after allocating large amounts of DSP memory.
+    /// @warning This may only be used before the renderer is activated!
+    ///   MADV_COLLAPSE blocks until the pages are collapsed, and the scan
+    ///   would also find memory which isn't DSP memory.
+    void advise_huge_pages()
+    {
+      if (!_huge_pages) return;
+#ifdef __linux__
+      std::ifstream maps("/proc/self/maps");
+      std::string line;
+      size_t total = 0;
+      unsigned long long previous_end = 0;
+      bool previous_guard = false;
+      while (std::getline(maps, line))
+      {
+        // Format: "start-end perms offset dev inode [pathname]"
+        std::istringstream iss(line);
+        std::string range, perms, offset, dev, inode, path;
+        iss >> range >> perms >> offset >> dev >> inode >> path;
+
+        auto dash = range.find('-');
+        auto start = std::stoull(range.substr(0, dash), nullptr, 16);
+        auto end = std::stoull(range.substr(dash + 1), nullptr, 16);
+        // Thread stacks are preceded by an inaccessible guard page
+        bool after_guard = previous_guard && previous_end == start;
+        previous_guard = perms.compare(0, 3, "---") == 0;
+        previous_end = end;
+
+        if (perms.compare(0, 2, "rw") != 0) continue;
+        if (inode != "0" || !(path.empty() || path == "[heap]")) continue;
+        if (after_guard) continue;
+
+        auto size = static_cast<size_t>(end - start);
+        if (size < huge_page_threshold) continue;
+
+        auto* address = reinterpret_cast<void*>(static_cast<uintptr_t>(start));
+        if (madvise(address, size, MADV_HUGEPAGE) != 0) continue;
+#ifdef MADV_COLLAPSE
+        // Don't wait for khugepaged (Linux >= 6.1), failure is not an error
+        madvise(address, size, MADV_COLLAPSE);
+#endif
+        total += size;
+      }
+      if (total > _advised)
+      {
+        SSR_VERBOSE2("Using huge pages for " << (total >> 20) << " MiB.");
+      }
+      _advised = total;
+#endif
+    }
+
+  private:
+    /// Value of @p key in /proc/self/status (empty if not found)
+    static std::string _status_field(const std::string& key)
+    {
+      std::ifstream status("/proc/self/status");
+      std::string line;
+      while (std::getline(status, line))
+      {
+        if (line.compare(0, key.size(), key) == 0)
+        {
+          auto value = std::string();
+          std::istringstream(line.substr(key.size())) >> value;
+          return value;
+        }
+      }
+      return "";
+    }
+
+    const bool _huge_pages;
+    bool _locked = false;
+    size_t _advised = 0;
+};
+
+}  // namespace ssr
+
+#endif
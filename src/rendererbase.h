@@ -30,8 +30,14 @@
 #ifndef SSR_RENDERERBASE_H
 #define SSR_RENDERERBASE_H
 
+#include <algorithm>  // for std::max()
+#include <cmath>  // for std::pow(), std::sqrt()
+#include <map>
+#include <memory>  // for std::unique_ptr
+#include <numeric>  // for std::iota()
 #include <string>
-#include <cstring>  // for std::strcmp()
+#include <type_traits>  // for std::void_t
+#include <vector>
 
 #include "apf/mimoprocessor.h"
 #include "apf/shareddata.h"
@@ -41,6 +47,12 @@
 
 #include "maptools.h"
 #include "geometry.h"  // for vec3
+#include "coalescedparameter.h"
+#include "rtcheck.h"
+#include "sourcearena.h"
+#include "sourcescheduler.h"
+#include "stagetimer.h"
+#include "threadlayout.h"
 
 #ifdef ENABLE_DYNAMIC_ASDF
 #include "dynamic_scene.h"
@@ -53,6 +65,85 @@
 namespace ssr
 {
 
+/// Source model, as used by the renderers.
+/// The API uses strings, they are converted with to_source_model() before
+/// they are passed to the audio thread.
+enum class SourceModel { point, plane, unknown };
+
+/// Convert the model string of the API (@c "point", @c "plane") to the
+/// according SourceModel.
+inline SourceModel to_source_model(const std::string& model)
+{
+  if (model == "point") return SourceModel::point;
+  if (model == "plane") return SourceModel::plane;
+  return SourceModel::unknown;
+}
+
+namespace internal
+{
+
+/// Can ports of @p T be connected after they were created?
+/// This is only possible with the JACK interface policy.
+template<typename T, typename = void>
+struct can_connect_ports : std::false_type {};
+
+template<typename T>
+struct can_connect_ports<T, std::void_t<decltype(std::declval<const T&>()
+  .connect_ports(std::string(), std::string()))>> : std::true_type {};
+
+/** Compute the weighting factors of @p n sources in one (vectorized) pass.
+ * The distance attenuation is applied to all sources with @p attenuate = 1,
+ * for sources with @p attenuate = 0 it is ignored.
+ * @param x, y, z Source positions
+ * @param gain Source gains (already zero for muted/inactive sources)
+ * @param attenuate 0 or 1
+ * @param weight Output array
+ * @param reference Position of the reference (including offset)
+ * @param factor Factor for all sources (e.g. master volume)
+ * @param exponent Exponent of the distance attenuation
+ * @param reference_distance Distance with 0 dB attenuation
+ **/
+template<typename T>
+void source_weights(size_t n, const T* __restrict x, const T* __restrict y
+    , const T* __restrict z, const T* __restrict gain
+    , const T* __restrict attenuate, T* __restrict weight
+    , const vec3& reference, T factor, T exponent, T reference_distance)
+{
+  const T rx = reference[0], ry = reference[1], rz = reference[2];
+
+  // Plane waves always have the same amplitude independent of the amplitude
+  // reference distance and the decay exponent, normalize all other sources
+  // accordingly
+  const T normalization = std::pow(reference_distance, exponent);
+
+  // NB: Both loops are vectorized, the branch is only taken once.
+  //     Sources closer than 0.5 m don't get a volume increase.
+  if (exponent == T(1))
+  {
+    // standard 1/r, which avoids pow()
+    for (size_t i = 0; i < n; ++i)
+    {
+      T dx = x[i] - rx, dy = y[i] - ry, dz = z[i] - rz;
+      T distance = std::max(std::sqrt(dx * dx + dy * dy + dz * dz), T(0.5));
+      T a = normalization / distance;
+      weight[i] = factor * gain[i] * (T(1) + attenuate[i] * (a - T(1)));
+    }
+  }
+  else
+  {
+    // 1/r^e
+    for (size_t i = 0; i < n; ++i)
+    {
+      T dx = x[i] - rx, dy = y[i] - ry, dz = z[i] - rz;
+      T distance = std::max(std::sqrt(dx * dx + dy * dy + dz * dz), T(0.5));
+      T a = normalization * std::pow(distance, -exponent);
+      weight[i] = factor * gain[i] * (T(1) + attenuate[i] * (a - T(1)));
+    }
+  }
+}
+
+}  // namespace internal
+
 /** Renderer base class.
  * The parallel rendering engine uses the non-blocking datastructure RtList to
  * communicate between realtime and non-realtime threads.
@@ -80,6 +171,11 @@ class RendererBase : public apf::MimoProcessor<Derived
     using SourceBase = Source;
     class Output;
 
+    /// Renderer traits, can be overwritten in @p Derived.
+    /// Apply distance attenuation to the weighting factor of all sources
+    /// (except plane waves)?
+    static constexpr bool distance_attenuation = true;
+
 #ifdef SSR_SHARED_IO_BUFFERS
     // Copying the input buffers is only needed if the backend re-uses its input
     // buffers as output buffers (e.g. Puredata externals) and if the renderer
@@ -111,13 +207,58 @@ class RendererBase : public apf::MimoProcessor<Derived
 #endif
 
 
+  protected:
+    // NB: This has to be initialized before the CoalescedParameter%s
+    CoalescingStatistics _coalescing_statistics;
+
+  public:
+    /// Counters of coalesced parameter updates (for all sources and state).
+    /// This can be used from any thread.
+    CoalescingStatistics::Counters get_coalescing_statistics() const
+    {
+      return _coalescing_statistics.get();
+    }
+
+    /// Fraction of time each audio thread spent processing sources.
+    /// This can be used from any thread.
+    std::vector<float> get_thread_utilization() const
+    {
+      return _scheduler.utilization();
+    }
+
+    /// CPU affinity, priority and NUMA node of the audio threads, as
+    /// configured (empty if nothing is configured).
+    std::string describe_thread_layout() const
+    {
+      return _thread_layout.describe();
+    }
+
+    /// Load of each processing stage and thread since the previous call,
+    /// see StageTimer::collect().  This has to be called from the control
+    /// thread.
+    /// @return @b false if DSP timing is disabled
+    bool get_dsp_timing(std::vector<std::vector<float>>& loads)
+    {
+      if (!_stage_timer.enabled()) return false;
+      _stage_timer.collect(loads);
+      return true;
+    }
+
+    /// Worker threads which have been set up since the last call.
+    /// This has to be called from the control thread, see ThreadLayout.
+    std::string report_thread_layout(std::string& errors)
+    {
+      return _thread_layout.report(errors);
+    }
+
     struct State
     {
-      State(apf::CommandQueue& fifo, const apf::parameter_map& params)
-        : reference_position(fifo)
-        , reference_rotation(fifo)
-        , reference_position_offset(fifo)
-        , reference_rotation_offset(fifo)
+      State(apf::CommandQueue& fifo, const apf::parameter_map& params
+          , CoalescingStatistics& statistics)
+        : reference_position(_dirty, 1 << 0, statistics)
+        , reference_rotation(_dirty, 1 << 1, statistics)
+        , reference_position_offset(_dirty, 1 << 2, statistics)
+        , reference_rotation_offset(_dirty, 1 << 3, statistics)
         , master_volume(fifo, 1)
         , processing(fifo, true)
         , decay_exponent(fifo, params.get<sample_type>("decay_exponent", 1))
@@ -125,14 +266,30 @@ class RendererBase : public apf::MimoProcessor<Derived
             , params.get<sample_type>("amplitude_reference_distance", 3))
       {}
 
-      apf::SharedData<Pos> reference_position;
-      apf::SharedData<Rot> reference_rotation;
-      apf::SharedData<Pos> reference_position_offset;
-      apf::SharedData<Rot> reference_rotation_offset;
+      /// Take over new values of the coalesced parameters (audio thread).
+      void update()
+      {
+        if (!_dirty.load(std::memory_order_relaxed)) return;
+
+        auto dirty = _dirty.exchange(0, std::memory_order_acquire);
+        if (dirty & (1 << 0)) reference_position.update();
+        if (dirty & (1 << 1)) reference_rotation.update();
+        if (dirty & (1 << 2)) reference_position_offset.update();
+        if (dirty & (1 << 3)) reference_rotation_offset.update();
+      }
+
+      // Updated by head trackers at high rates, therefore not in the fifo:
+      CoalescedParameter<Pos> reference_position;
+      CoalescedParameter<Rot> reference_rotation;
+      CoalescedParameter<Pos> reference_position_offset;
+      CoalescedParameter<Rot> reference_rotation_offset;
       apf::SharedData<sample_type> master_volume;
       apf::SharedData<bool> processing;
       apf::SharedData<sample_type> decay_exponent;
       apf::SharedData<sample_type> amplitude_reference_distance;
+
+    private:
+      std::atomic<unsigned> _dirty{0};  ///< bitmap of changed parameters
     } state;
 
     // If you don't need a list proxy, just use a reference to the list
@@ -160,9 +317,9 @@ class RendererBase : public apf::MimoProcessor<Derived
         DataMember _member;
     };
 
-#ifdef ENABLE_DYNAMIC_ASDF
     struct Process;
 
+#ifdef ENABLE_DYNAMIC_ASDF
     std::vector<DynamicSourceInfo>
     load_dynamic_scene(const std::string& scene_file_name
         , const std::string& input_port_prefix);
@@ -171,7 +328,7 @@ class RendererBase : public apf::MimoProcessor<Derived
     template<typename L, typename ListProxy, typename DataMember>
     void add_to_sublist(const L& input, ListProxy output, DataMember member)
     {
-      _fifo.push(new AddToSublistCommand<L, ListProxy, DataMember>(
+      _push(new AddToSublistCommand<L, ListProxy, DataMember>(
             input, output, member));
     }
 
@@ -206,16 +363,29 @@ class RendererBase : public apf::MimoProcessor<Derived
     template<typename L, typename ListProxy, typename DataMember>
     void rem_from_sublist(const L& input, ListProxy output, DataMember member)
     {
-      _fifo.push(new RemFromSublistCommand<L, ListProxy, DataMember>(
+      _push(new RemFromSublistCommand<L, ListProxy, DataMember>(
             input, output, member));
     }
 
+    /// Parameters for one source created with add_sources().
+    struct SourceRequest
+    {
+      id_t id;  ///< requested ID, an empty string to get a generated one
+      apf::parameter_map params;
+      const float* file_source_ptr = nullptr;
+    };
+
     std::string add_source(id_t id
         , const apf::parameter_map& p = apf::parameter_map()
         , const float* file_source_ptr = nullptr);
+    std::vector<std::string>
+    add_sources(const std::vector<SourceRequest>& requests);
     void rem_source(id_t id);
+    void rem_sources(const std::vector<std::string>& ids);
     void rem_all_sources();
 
+    void fill_input_pool();
+
     Source* get_source(id_t id);
 
     // May only be used in realtime thread!
@@ -229,6 +399,11 @@ class RendererBase : public apf::MimoProcessor<Derived
 
     auto get_scoped_lock() { return std::make_unique<ScopedLock>(_lock); }
 
+    /// Non-realtime maintenance (e.g. re-allocating buffers).
+    /// This is called periodically from the control thread while the
+    /// controller lock is held. Derived classes can shadow this function.
+    void housekeeping() {}
+
     const sample_type master_volume_correction;  // linear
 
 #ifdef ENABLE_DYNAMIC_ASDF
@@ -247,12 +422,116 @@ class RendererBase : public apf::MimoProcessor<Derived
     // TODO: make private?
     sample_type _master_level;
 
+    /// Memory for Source objects (and their SourceChannel%s etc.).
+    /// NB: This must be declared before (i.e. destroyed after) _source_list.
+    SourceArena _source_arena;
+
     rtlist_t _source_list;
 
+    /// Items which are processed together with the sources, but which don't
+    /// depend on them (e.g. outputs of the previous block when pipelining).
+    /// This must not be changed while the renderer is active.
+    std::vector<typename _base::Item*> _pipelined_items;
+
+    /// Processing time per stage and thread (if "dsp_timing" is enabled)
+    StageTimer _stage_timer;
+
     // TODO: find a better solution to get loudspeaker vs. headphone renderer
     bool _show_head;
 
+    /// Call @p f for each Derived::Source. Must not be used in realtime thread!
+    template<typename F>
+    void _for_each_source(F&& f)
+    {
+      for (auto& entry: _source_map)
+      {
+        f(entry.second->derived());
+      }
+    }
+
   private:
+    /// Several commands which are executed in one go by the audio thread.
+    class CommandBatch : public apf::CommandQueue::Command
+    {
+      public:
+        void add(apf::CommandQueue::Command* cmd)
+        {
+          _commands.emplace_back(cmd);
+        }
+
+        bool empty() const { return _commands.empty(); }
+
+        virtual void execute()
+        {
+          for (auto& cmd: _commands) cmd->execute();
+        }
+
+        virtual void cleanup()
+        {
+          for (auto& cmd: _commands) cmd->cleanup();
+        }
+
+      private:
+        std::vector<std::unique_ptr<apf::CommandQueue::Command>> _commands;
+    };
+
+    /// Push @p cmd to the FIFO or, during add_sources()/rem_sources(), collect
+    /// it in the current batch.
+    void _push(apf::CommandQueue::Command* cmd)
+    {
+      if (_batch)
+      {
+        _batch->add(cmd);
+      }
+      else
+      {
+        _fifo.push(cmd);
+      }
+    }
+
+    /// Push all commands collected since _batch was created as one command.
+    void _flush_batch()
+    {
+      assert(_batch);
+      if (_batch->empty())
+      {
+        _batch.reset();
+      }
+      else
+      {
+        _fifo.push(_batch.release());
+      }
+    }
+
+    /// Collect all commands pushed during the lifetime of this object in one
+    /// CommandBatch.  The batch is flushed on every exit path, also if an
+    /// exception is thrown, therefore _batch is never left behind and the
+    /// commands which were already pushed are not lost.
+    class BatchScope
+    {
+      public:
+        explicit BatchScope(RendererBase& parent)
+          : _parent(parent)
+        {
+          assert(!_parent._batch);
+          _parent._batch = std::make_unique<CommandBatch>();
+        }
+
+        ~BatchScope() { _parent._flush_batch(); }
+
+        BatchScope(const BatchScope&) = delete;
+        BatchScope& operator=(const BatchScope&) = delete;
+
+      private:
+        RendererBase& _parent;
+    };
+
+    std::string _new_source_id(id_t requested_id);
+    typename Derived::Source::Params _source_params(const std::string& id
+        , const apf::parameter_map& p, const float* file_source_ptr);
+    const typename Derived::Input* _claim_input(const apf::parameter_map& p);
+    void _rem_input(const typename Derived::Input* input);
+
     apf::parameter_map _add_params(const apf::parameter_map& params)
     {
       auto temp = params;
@@ -262,6 +541,47 @@ class RendererBase : public apf::MimoProcessor<Derived
 
     std::map<std::string, Source*, std::less<>> _source_map;
 
+    std::unique_ptr<CommandBatch> _batch;
+
+    /// Per-block parameters of all sources as structure of arrays.
+    /// The arrays are filled in Process (in the order of the source list),
+    /// then the weighting factors of all sources are computed in one pass.
+    struct SourceArrays
+    {
+      explicit SourceArrays(size_t capacity)
+        : x(capacity), y(capacity), z(capacity)
+        , gain(capacity), attenuate(capacity), weight(capacity)
+        , sources(capacity), cost(capacity), order(capacity)
+      {
+        // A valid permutation, even before the first sorting
+        std::iota(order.begin(), order.end(), size_t(0));
+      }
+
+      size_t capacity() const { return weight.size(); }
+
+      std::vector<sample_type> x, y, z, gain, attenuate, weight;
+
+      // For the SourceScheduler:
+      std::vector<typename Derived::Source*> sources;
+      std::vector<float> cost;
+      std::vector<size_t> order;
+    };
+
+    void _reserve_source_arrays(size_t sources);
+
+    apf::SharedData<std::unique_ptr<SourceArrays>> _source_arrays;
+    size_t _source_arrays_capacity = 0;  ///< only used in control thread
+
+    SourceScheduler _scheduler;
+    ThreadLayout _thread_layout;
+
+    /// Number of Inputs which are kept in stock, see fill_input_pool()
+    const size_t _input_pool_size;
+    /// Inputs (and their ports) which are not used by any source
+    std::vector<const typename Derived::Input*> _input_pool;
+    /// Port each Input has been connected to (only if the pool is used)
+    std::map<const typename Derived::Input*, std::string> _input_connections;
+
     size_t _next_id_suffix = 0;
 
     std::mutex _lock;
@@ -288,7 +608,7 @@ class RendererBase : public apf::MimoProcessor<Derived
 template<typename Derived>
 RendererBase<Derived>::RendererBase(const apf::parameter_map& p)
   : _base(_add_params(p))
-  , state(_fifo, p)
+  , state(_fifo, p, _coalescing_statistics)
   , master_volume_correction(apf::math::dB2linear(
         this->params.get("master_volume_correction", 0.0)))
 #ifdef ENABLE_DYNAMIC_ASDF
@@ -296,12 +616,21 @@ RendererBase<Derived>::RendererBase(const apf::parameter_map& p)
   , freewheeling(this->params.get("freewheeling", false))
 #endif
   , _master_level()
+  , _source_arena(this->params.get("source_slab_size", size_t(2 << 20))
+      , this->params.get("huge_pages", false))
   , _source_list(_fifo)
+  , _stage_timer(this->params.get("dsp_timing", false))
   , _show_head(true)
+  , _input_pool_size(this->params.get("source_pool_size", size_t(0)))
+  , _source_arrays(_fifo)
+  , _scheduler(static_cast<double>(this->block_size()) / this->sample_rate())
+  , _thread_layout(this->params)
 #ifdef ENABLE_DYNAMIC_ASDF
   , _scene(_fifo)
 #endif
-{}
+{
+  _reserve_source_arrays(this->params.get("expected_sources", size_t(32)));
+}
 
 /** Create a new source.
  * @return ID of new source
@@ -311,6 +640,220 @@ template<typename Derived>
 std::string
 RendererBase<Derived>::add_source(id_t requested_id
     , const apf::parameter_map& p, const float* file_source_ptr)
+{
+  auto id = _new_source_id(requested_id);
+  auto src_params = _source_params(id, p, file_source_ptr);
+  _reserve_source_arrays(_source_map.size() + 1);
+
+  // NB: Some renderers allocate per-source state in connect()
+  SourceArena::Scope scope(_source_arena);
+
+  typename Derived::Source* src;
+  try
+  {
+    src = _source_list.add(new typename Derived::Source(src_params));
+  }
+  catch (...)
+  {
+    _rem_input(src_params.input);
+    throw;
+  }
+
+  // This cannot be done in the Derived::Source constructor because then the
+  // connections to the Outputs are active before the Source is properly added
+  // to the source list:
+  src->connect();
+
+  _source_map[id] = src;
+  return id;
+}
+
+/** Create several sources at once.
+ * All sources are constructed in the calling thread, they are added to the
+ * source list with a single command and all their connections are made with
+ * another single command.
+ * This is much faster than calling add_source() repeatedly, because the
+ * audio thread has to process only two commands instead of a few per source.
+ * Inputs (and therefore JACK ports) are still created one by one.
+ * @return IDs of the new sources, in the order of @p requests
+ * @throw unknown whatever the Derived::Source constructor throws.
+ *   In this case, none of the sources are created.
+ **/
+template<typename Derived>
+std::vector<std::string>
+RendererBase<Derived>::add_sources(const std::vector<SourceRequest>& requests)
+{
+  auto ids = std::vector<std::string>();
+  auto sources = std::vector<typename Derived::Source*>();
+  ids.reserve(requests.size());
+  sources.reserve(requests.size());
+
+  // Clean up everything created so far
+  auto rollback = [this, &sources]()
+  {
+    for (auto* src: sources)
+    {
+      _source_map.erase(src->id);
+      _rem_input(src->_input);
+      delete src;
+    }
+  };
+
+  // All new sources are placed next to each other
+  SourceArena::Scope scope(_source_arena);
+
+  for (const auto& request: requests)
+  {
+    try
+    {
+      // Sources are added to _source_map early to detect duplicate IDs
+      auto id = _new_source_id(request.id);
+      auto src_params = _source_params(id, request.params
+          , request.file_source_ptr);
+      try
+      {
+        sources.push_back(new typename Derived::Source(src_params));
+      }
+      catch (...)
+      {
+        _rem_input(src_params.input);
+        throw;
+      }
+      _source_map[id] = sources.back();
+      ids.push_back(id);
+    }
+    catch (...)
+    {
+      rollback();
+      throw;
+    }
+  }
+
+  if (sources.empty())
+  {
+    return ids;
+  }
+
+  // NB: _source_map already contains the new sources
+  _reserve_source_arrays(_source_map.size());
+  _source_list.add(sources.begin(), sources.end());
+
+  // See add_source() for why this is done only after adding to the list
+  {
+    BatchScope batch(*this);
+    for (auto* src: sources)
+    {
+      src->connect();
+    }
+  }
+
+  return ids;
+}
+
+template<typename Derived>
+void RendererBase<Derived>::rem_source(id_t id)
+{
+  auto delinquent = _source_map.find(id);
+
+  if (delinquent == _source_map.end())
+  {
+    // TODO: warning?
+    return;
+  }
+
+  auto* source = delinquent->second;
+
+  _source_map.erase(delinquent);
+
+  assert(source);
+  source->derived().disconnect();
+
+  auto* input = source->_input;
+  _source_list.rem(source);
+  _rem_input(input);
+}
+
+/** Remove several sources at once.
+ * This is the counterpart of add_sources(): all sources are disconnected with
+ * a single command and removed from the source list with another one.
+ * Unknown IDs are ignored.
+ **/
+template<typename Derived>
+void RendererBase<Derived>::rem_sources(const std::vector<std::string>& ids)
+{
+  auto sources = std::vector<Source*>();
+  auto inputs = std::vector<const typename Derived::Input*>();
+  sources.reserve(ids.size());
+  inputs.reserve(ids.size());
+
+  for (const auto& id: ids)
+  {
+    auto delinquent = _source_map.find(id);
+    if (delinquent == _source_map.end())
+    {
+      continue;
+    }
+    assert(delinquent->second);
+    sources.push_back(delinquent->second);
+    inputs.push_back(delinquent->second->_input);
+    _source_map.erase(delinquent);
+  }
+
+  if (sources.empty())
+  {
+    return;
+  }
+
+  {
+    BatchScope batch(*this);
+    for (auto* source: sources)
+    {
+      source->derived().disconnect();
+    }
+  }
+
+  // NB: The sources may be deleted as soon as further commands are pushed,
+  // that's why the inputs were collected above.
+  _source_list.rem(sources.begin(), sources.end());
+  for (auto* input: inputs)
+  {
+    _rem_input(input);
+  }
+}
+
+template<typename Derived>
+void RendererBase<Derived>::rem_all_sources()
+{
+  auto ids = std::vector<std::string>();
+  ids.reserve(_source_map.size());
+  for (const auto& entry: _source_map)
+  {
+    ids.push_back(entry.first);
+  }
+  this->rem_sources(ids);
+}
+
+/** Make sure that the SourceArrays can hold the given number of sources.
+ * If not, a larger set of arrays is handed to the audio thread.
+ * This has to be called before new sources are added to the source list.
+ **/
+template<typename Derived>
+void RendererBase<Derived>::_reserve_source_arrays(size_t sources)
+{
+  if (sources <= _source_arrays_capacity)
+  {
+    return;
+  }
+  _source_arrays_capacity = std::max(sources, 2 * _source_arrays_capacity);
+  _source_arrays = std::make_unique<SourceArrays>(_source_arrays_capacity);
+}
+
+/** Check a requested source ID or generate a new one.
+ * @throw std::runtime_error if @p requested_id is already in use
+ **/
+template<typename Derived>
+std::string
+RendererBase<Derived>::_new_source_id(id_t requested_id)
 {
   std::string id = requested_id;
   if (id.size() && _source_map.find(id) != _source_map.end())
@@ -325,7 +868,15 @@ RendererBase<Derived>::add_source(id_t requested_id
     }
     while (_source_map.find(id) != _source_map.end());
   }
+  return id;
+}
 
+/// Create the source parameters, including a new Input (if needed).
+template<typename Derived>
+typename Derived::Source::Params
+RendererBase<Derived>::_source_params(const std::string& id
+    , const apf::parameter_map& p, const float* file_source_ptr)
+{
   typename Derived::Source::Params src_params;
   src_params = p;
   src_params.parent = &this->derived();
@@ -334,11 +885,7 @@ RendererBase<Derived>::add_source(id_t requested_id
 
   if (file_source_ptr == nullptr)
   {
-    typename Derived::Input::Params in_params;
-    in_params = p;
-    auto in = this->add(in_params);
-    // WARNING: if Derived::Input throws an exception, the SSR crashes!
-    src_params.input = in;
+    src_params.input = _claim_input(p);
   }
   else
   {
@@ -348,68 +895,101 @@ RendererBase<Derived>::add_source(id_t requested_id
     assert(false);
 #endif
   }
+  return src_params;
+}
 
-  typename Derived::Source* src;
-  try
-  {
-    src = _source_list.add(new typename Derived::Source(src_params));
-  }
-  catch (...)
+/** Pre-register Inputs (and their JACK ports) for new sources.
+ * The number of Inputs is given by the parameter @c source_pool_size.
+ * add_source() takes an Input from this pool (instead of registering a new
+ * port) and connects it to the port given by @c connect-to.
+ * rem_source() disconnects the Input and puts it back.
+ * This does nothing if the ports cannot be re-connected (i.e. without JACK).
+ **/
+template<typename Derived>
+void RendererBase<Derived>::fill_input_pool()
+{
+  if constexpr (internal::can_connect_ports<Derived>::value)
   {
-    if (src_params.input)
+    while (_input_pool.size() < _input_pool_size)
     {
-      auto* input = const_cast<typename Derived::Input*>(src_params.input);
-      this->rem(input);
+      typename Derived::Input::Params in_params;
+      _input_pool.push_back(this->add(in_params));
     }
-    throw;
   }
-
-  // This cannot be done in the Derived::Source constructor because then the
-  // connections to the Outputs are active before the Source is properly added
-  // to the source list:
-  src->connect();
-
-  _source_map[id] = src;
-  return id;
 }
 
+/// Get an Input from the pool or create a new one.
 template<typename Derived>
-void RendererBase<Derived>::rem_source(id_t id)
+const typename Derived::Input*
+RendererBase<Derived>::_claim_input(const apf::parameter_map& p)
 {
-  auto delinquent = _source_map.find(id);
-
-  if (delinquent == _source_map.end())
+  if constexpr (internal::can_connect_ports<Derived>::value)
   {
-    // TODO: warning?
-    return;
+    if (_input_pool_size > 0)
+    {
+      auto port = p.get("connect-to", "");
+      const typename Derived::Input* input;
+      if (_input_pool.empty())
+      {
+        typename Derived::Input::Params in_params;
+        in_params = p;
+        input = this->add(in_params);
+      }
+      else
+      {
+        input = _input_pool.back();
+        _input_pool.pop_back();
+        if (port != "")
+        {
+          this->connect_ports(port, input->port_name());
+        }
+      }
+      _input_connections[input] = port;
+      return input;
+    }
   }
 
-  auto* source = delinquent->second;
-
-  _source_map.erase(delinquent);
-
-  assert(source);
-  source->derived().disconnect();
-
-  auto* input = const_cast<typename Derived::Input*>(source->_input);
-  _source_list.rem(source);
+  typename Derived::Input::Params in_params;
+  in_params = p;
+  // WARNING: if Derived::Input throws an exception, the SSR crashes!
+  return this->add(in_params);
+}
 
+/// Remove the Input of a source (if there is one) or return it to the pool.
+template<typename Derived>
+void
+RendererBase<Derived>::_rem_input(const typename Derived::Input* input)
+{
   // TODO: really remove the corresponding Input?
   // ATTENTION: there may be several sources using the input! (or not?)
 
-  if (input != nullptr)
+  if (input == nullptr)
   {
-    this->rem(input);
+    return;
   }
-}
 
-template<typename Derived>
-void RendererBase<Derived>::rem_all_sources()
-{
-  while (!_source_map.empty())
+  if constexpr (internal::can_connect_ports<Derived>::value)
   {
-    this->rem_source(_source_map.begin()->first);
+    auto connection = _input_connections.find(input);
+    if (connection != _input_connections.end())
+    {
+      if (_input_pool.size() < _input_pool_size)
+      {
+        if (connection->second != "")
+        {
+          this->disconnect_ports(connection->second, input->port_name());
+        }
+        // NB: The old source may still use it until it is removed from the
+        //     source list, but that's harmless, because it's only read.
+        _input_pool.push_back(input);
+        _input_connections.erase(connection);
+        return;
+      }
+      _input_connections.erase(connection);
+    }
   }
+
+  this->rem(const_cast<typename Derived::Input*>(input));
 }
 
 
@@ -429,7 +1009,6 @@ RendererBase<Derived>::get_source(id_t id)
 }
 
 
-#ifdef ENABLE_DYNAMIC_ASDF
 // NB: The APF_PROCESS macro doesn't work here because of the use of CRTP.
 template<typename Derived>
 struct RendererBase<Derived>::Process : _base::Process
@@ -437,125 +1016,202 @@ struct RendererBase<Derived>::Process : _base::Process
   Process(Derived& parent)
     : _base::Process(parent)
   {
-    const auto& scene = parent._scene.get();
-    if (!scene) return;
+    rtcheck::mark_realtime_thread();
+    parent._thread_layout.setup_main_thread();
+    StageTimer::Scope timer(parent._stage_timer, StageTimer::prepare);
+
+    parent.state.update();
 
-    assert(parent.dynamic_sources != nullptr);
-    auto& source_list = *parent.dynamic_sources.get();
-    assert(source_list.size() == scene->file_sources() + scene->live_sources());
+#ifdef ENABLE_DYNAMIC_ASDF
+    _update_dynamic_scene(parent);
+#endif
 
-    auto [rolling, transport_frame] = parent.get_transport_state();
+    _update_source_weights(parent);
+  }
 
-    while (true)
+  private:
+#ifdef ENABLE_DYNAMIC_ASDF
+    static void _update_dynamic_scene(Derived& parent)
     {
-      auto result = scene->update_audio_data(rolling);
-      if (result == ASDF_STREAMING_SUCCESS)
-      {
-        break;
-      }
-      else if (result == ASDF_STREAMING_EMPTY_BUFFER)
+      const auto& scene = parent._scene.get();
+      if (!scene) return;
+
+      assert(parent.dynamic_sources != nullptr);
+      auto& source_list = *parent.dynamic_sources.get();
+      assert(source_list.size()
+          == scene->file_sources() + scene->live_sources());
+
+      auto [rolling, transport_frame] = parent.get_transport_state();
+
+      while (true)
       {
-        if (parent.freewheeling)
+        auto result = scene->update_audio_data(rolling);
+        if (result == ASDF_STREAMING_SUCCESS)
         {
-          // Do nothing, just try again later ...
+          break;
         }
-        else
+        else if (result == ASDF_STREAMING_EMPTY_BUFFER)
+        {
+          if (parent.freewheeling)
+          {
+            // Do nothing, just try again later ...
+          }
+          else
+          {
+            SSR_ERROR("ASDF streaming: empty buffer");
+            throw std::runtime_error("exiting callback");
+          }
+        }
+        else if (result == ASDF_STREAMING_INCOMPLETE_SEEK)
         {
-          SSR_ERROR("ASDF streaming: empty buffer");
+          SSR_ERROR("Bug: incomplete seek");
           throw std::runtime_error("exiting callback");
         }
+        else if (result == ASDF_STREAMING_SEEK_WHILE_ROLLING)
+        {
+          SSR_ERROR("Bug: seek while rolling");
+          throw std::runtime_error("exiting callback");
+        }
+        else
+        {
+          assert(false);
+        }
+        std::this_thread::sleep_for(
+            std::chrono::microseconds(parent.usleeptime));
       }
-      else if (result == ASDF_STREAMING_INCOMPLETE_SEEK)
-      {
-        SSR_ERROR("Bug: incomplete seek");
-        throw std::runtime_error("exiting callback");
-      }
-      else if (result == ASDF_STREAMING_SEEK_WHILE_ROLLING)
-      {
-        SSR_ERROR("Bug: seek while rolling");
-        throw std::runtime_error("exiting callback");
-      }
-      else
-      {
-        assert(false);
-      }
-      std::this_thread::sleep_for(std::chrono::microseconds(parent.usleeptime));
-    }
-
-    {
-      auto t = scene->get_reference_transform(transport_frame);
-      auto rotation = t.rot;
-      if (rotation != parent.dynamic_reference.rot) {
-        parent.dynamic_reference.rot = rotation;
-        parent.state.reference_rotation.set_from_rt_thread(rotation);
-      }
-      auto position = t.pos;
-      if (position != parent.dynamic_reference.pos) {
-        parent.dynamic_reference.pos = position;
-        parent.state.reference_position.set_from_rt_thread(position);
-      }
-      auto volume = t.vol;
-      if (volume != parent.dynamic_reference.vol) {
-        parent.dynamic_reference.vol = volume;
-        parent.state.master_volume.set_from_rt_thread(std::move(volume));
-      }
-    }
-
-    // NB: Functions for checking dynamic sources are not thread safe,
-    //     therefore we call them in a loop from a single thread.
 
-    for (auto& source: apf::cast_proxy<typename Derived::Source, rtlist_t>(
-          parent._source_list))
-    {
-      size_t source_number = source.dynamic_number;
-      if (source_number == static_cast<size_t>(-1))
-      {
-        continue;  // This source is not part of the dynamic ASDF scene
-      }
-      auto transform = scene->get_source_transform(
-          source_number, transport_frame);
-      auto& target_transform = source_list[source_number];
-      if (transform)
       {
-        if (target_transform == std::nullopt)
-        {
-          source.active.set_from_rt_thread(true);
-          target_transform = ssr::Transform{};
+        auto t = scene->get_reference_transform(transport_frame);
+        auto rotation = t.rot;
+        if (rotation != parent.dynamic_reference.rot) {
+          parent.dynamic_reference.rot = rotation;
+          parent.state.reference_rotation.set_from_rt_thread(rotation);
         }
-
-        auto rotation = transform->rot;
-        if (rotation != target_transform->rot)
-        {
-          target_transform->rot = rotation;
-          source.rotation.set_from_rt_thread(rotation);
+        auto position = t.pos;
+        if (position != parent.dynamic_reference.pos) {
+          parent.dynamic_reference.pos = position;
+          parent.state.reference_position.set_from_rt_thread(position);
         }
+        auto volume = t.vol;
+        if (volume != parent.dynamic_reference.vol) {
+          parent.dynamic_reference.vol = volume;
+          parent.state.master_volume.set_from_rt_thread(std::move(volume));
+        }
+      }
+
+      // NB: Functions for checking dynamic sources are not thread safe,
+      //     therefore we call them in a loop from a single thread.
 
-        auto position = transform->pos;
-        if (position != target_transform->pos)
+      for (auto& source: apf::cast_proxy<typename Derived::Source, rtlist_t>(
+            parent._source_list))
+      {
+        size_t source_number = source.dynamic_number;
+        if (source_number == static_cast<size_t>(-1))
         {
-          target_transform->pos = position;
-          source.position.set_from_rt_thread(position);
+          continue;  // This source is not part of the dynamic ASDF scene
         }
-
-        auto volume = transform->vol;
-        if (volume != target_transform->vol)
+        auto transform = scene->get_source_transform(
+            source_number, transport_frame);
+        auto& target_transform = source_list[source_number];
+        if (transform)
         {
-          target_transform->vol = volume;
-          source.gain.set_from_rt_thread(std::move(volume));
+          if (target_transform == std::nullopt)
+          {
+            source.active.set_from_rt_thread(true);
+            target_transform = ssr::Transform{};
+          }
+
+          auto rotation = transform->rot;
+          if (rotation != target_transform->rot)
+          {
+            target_transform->rot = rotation;
+            source.rotation.set_from_rt_thread(rotation);
+          }
+
+          auto position = transform->pos;
+          if (position != target_transform->pos)
+          {
+            target_transform->pos = position;
+            source.position.set_from_rt_thread(position);
+          }
+
+          auto volume = transform->vol;
+          if (volume != target_transform->vol)
+          {
+            target_transform->vol = volume;
+            source.gain.set_from_rt_thread(std::move(volume));
+          }
         }
-      }
-      else
-      {
-        if (target_transform)
+        else
         {
-          source.active.set_from_rt_thread(false);
+          if (target_transform)
+          {
+            source.active.set_from_rt_thread(false);
+          }
+          target_transform = std::nullopt;
         }
-        target_transform = std::nullopt;
       }
     }
-  }
+#endif
+
+    static void _update_source_weights(Derived& parent);
 };
 
+/** Take over the parameters of all sources and compute their weighting factors.
+ * The parameters are copied to contiguous arrays (see SourceArrays), which
+ * allows computing the distance attenuation of all sources in one vectorized
+ * pass, before the sources are processed (in parallel).
+ * This also prepares the processing order for the SourceScheduler.
+ **/
+template<typename Derived>
+void RendererBase<Derived>::Process::_update_source_weights(Derived& parent)
+{
+  const auto& arrays_ptr = parent._source_arrays.get();
+  assert(arrays_ptr);
+  auto& arrays = *arrays_ptr;
+
+  size_t n = 0;
+  for (auto& source: apf::cast_proxy<typename Derived::Source, rtlist_t>(
+        parent._source_list))
+  {
+    source._update_parameters();
+
+    // NB: This cannot happen, see _reserve_source_arrays()
+    assert(n < arrays.capacity());
+
+    const Pos& position = source.position;
+    arrays.x[n] = position.x;
+    arrays.y[n] = position.y;
+    arrays.z[n] = position.z;
+    arrays.gain[n] = (source.mute || !source.active) ? 0 : source.gain.get();
+    arrays.attenuate[n] = Derived::distance_attenuation
+      && source.model != SourceModel::plane;
+    arrays.sources[n] = &source;
+    arrays.cost[n] = source._cost;
+    source._index = n++;
+  }
+
+  parent._scheduler.prepare(arrays.order.data(), arrays.cost.data(), n
+      , parent._pipelined_items.size());
+
+  sample_type factor = 0;
+  if (parent.state.processing)
+  {
+    // If the renderer does something nonlinear, the master volume should
+    // be applied to the output signal ... TODO: shall we care?
+    factor = parent.state.master_volume * parent.master_volume_correction;
+  }
+
+  internal::source_weights(n, arrays.x.data(), arrays.y.data()
+      , arrays.z.data(), arrays.gain.data(), arrays.attenuate.data()
+      , arrays.weight.data()
+      , vec3{parent.state.reference_position.get()}
+        + vec3{parent.state.reference_position_offset.get()}
+      , factor, parent.state.decay_exponent.get()
+      , parent.state.amplitude_reference_distance.get());
+}
+
+#ifdef ENABLE_DYNAMIC_ASDF
 
 /// This has to be called while the controller lock is held.
 /// All existing sources must be removed before calling this.
@@ -597,6 +1253,8 @@ RendererBase<Derived>::load_dynamic_scene(const std::string& scene_file_name
 
   std::vector<DynamicSourceInfo> sources;
   sources.reserve(total_sources);
+  std::vector<SourceRequest> requests;
+  requests.reserve(total_sources);
 
   for (size_t i = 0; i < total_sources; i++)
   {
@@ -619,20 +1277,20 @@ RendererBase<Derived>::load_dynamic_scene(const std::string& scene_file_name
 
     p.set("dynamic-number", i);
 
-    try
-    {
-      auto id = this->add_source(source.id, p, file_source_ptr);
-      assert(source.id == "" || id == source.id);  // IDs must be unique
-      assert(id != "");
-      source.id = id;
-    }
-    catch (std::exception& e)
-    {
-      this->rem_all_sources();
-      throw;
-    }
+    requests.push_back({source.id, std::move(p), file_source_ptr});
     sources.push_back(std::move(source));
   }
+
+  // All sources are created at once, if one fails, none are created
+  auto ids = this->add_sources(requests);
+  assert(ids.size() == sources.size());
+  for (size_t i = 0; i < ids.size(); ++i)
+  {
+    // IDs must be unique
+    assert(sources[i].id == "" || ids[i] == sources[i].id);
+    assert(ids[i] != "");
+    sources[i].id = ids[i];
+  }
   SSR_VERBOSE("Loaded scene with "
       << file_sources << " file source(s) and "
       << live_sources << " live source(s).");
@@ -662,6 +1320,19 @@ class RendererBase<Derived>::Source
 
     friend class RendererBase<Derived>;  // rem_source() needs access to _input
 
+    /// Sources are allocated from the SourceArena of the renderer.
+    /// They are deleted (and the memory is reclaimed) in the cleanup of the
+    /// command queue, i.e. not in the realtime thread.
+    static void* operator new(size_t size)
+    {
+      return SourceArena::allocate(size);
+    }
+
+    static void operator delete(void* ptr)
+    {
+      SourceArena::deallocate(ptr);
+    }
+
     struct Params : apf::parameter_map
     {
       Derived* parent = nullptr;
@@ -678,13 +1349,14 @@ class RendererBase<Derived>::Source
     explicit Source(const Params& p)
       : parent(*(p.parent ? p.parent : throw std::logic_error(
               "Bug (RendererBase::Source): parent == NULL!")))
-      , active(*p.fifo, false)
-      , position(*(p.fifo ? p.fifo : throw std::logic_error(
-              "Bug (RendererBase::Source): fifo == NULL!")))
-      , rotation(*p.fifo)
-      , gain(*p.fifo, sample_type(1.0))
+      , active(*(p.fifo ? p.fifo : throw std::logic_error(
+              "Bug (RendererBase::Source): fifo == NULL!")), false)
+      , position(_dirty, _position_bit, parent._coalescing_statistics)
+      , rotation(_dirty, _rotation_bit, parent._coalescing_statistics)
+      , gain(_dirty, _gain_bit, parent._coalescing_statistics
+          , sample_type(1.0))
       , mute(*p.fifo, false)
-      , model(*p.fifo, "point")
+      , model(*p.fifo, SourceModel::point)
       , weighting_factor()
       , id(p.id)
 #ifdef ENABLE_DYNAMIC_ASDF
@@ -719,6 +1391,38 @@ class RendererBase<Derived>::Source
       this->_process();
     }
 
+    /// Process this source or any other one, see SourceScheduler.
+    void process() override
+    {
+      auto& scheduler = this->parent._scheduler;
+      auto& timer = this->parent._stage_timer;
+      const auto& arrays = *this->parent._source_arrays.get();
+      const auto& extra = this->parent._pipelined_items;
+      auto process_extra = [&extra](size_t i) { extra[i]->process(); };
+      if (scheduler.measuring())
+      {
+        scheduler.run([&arrays, &timer](size_t i)
+        {
+          auto* source = arrays.sources[i];
+          StageTimer::Scope scope(timer, StageTimer::sources);
+          auto start = SourceScheduler::clock::now();
+          source->SourceBase::process();
+          float cost = std::chrono::duration<float>(
+              SourceScheduler::clock::now() - start).count();
+          // Moving average over the last few measurements
+          source->_cost = 0.75f * source->_cost + 0.25f * cost;
+        }, process_extra);
+      }
+      else
+      {
+        scheduler.run([&arrays, &timer](size_t i)
+        {
+          StageTimer::Scope scope(timer, StageTimer::sources);
+          arrays.sources[i]->SourceBase::process();
+        }, process_extra);
+      }
+    }
+
     sample_type get_level() const { return _level; }
 
     // In the default case, the output levels are ignored
@@ -742,11 +1446,12 @@ class RendererBase<Derived>::Source
     Derived& parent;
 
     apf::SharedData<bool> active;
-    apf::SharedData<Pos> position;
-    apf::SharedData<Rot> rotation;
-    apf::SharedData<sample_type> gain;
+    // These are typically updated at high rates, therefore not in the fifo:
+    CoalescedParameter<Pos> position;
+    CoalescedParameter<Rot> rotation;
+    CoalescedParameter<sample_type> gain;
     apf::SharedData<bool> mute;
-    apf::SharedData<std::string> model;
+    apf::SharedData<SourceModel> model;
 
     apf::BlockParameter<sample_type> weighting_factor;
 
@@ -761,6 +1466,20 @@ class RendererBase<Derived>::Source
   private:
     void _process();
 
+    /// Take over the latest values from the control thread
+    void _update_parameters()
+    {
+      if (_dirty.load(std::memory_order_relaxed))
+      {
+        auto dirty = _dirty.exchange(0, std::memory_order_acquire);
+        if (dirty & _position_bit) this->position.update();
+        if (dirty & _rotation_bit) this->rotation.update();
+        if (dirty & _gain_bit) this->gain.update();
+      }
+    }
+
+    enum { _position_bit = 1 << 0, _rotation_bit = 1 << 1, _gain_bit = 1 << 2 };
+
     void _level_helper(apf::enable_queries&)
     {
       _pre_fader_level
@@ -772,11 +1491,24 @@ class RendererBase<Derived>::Source
 
     sample_type _pre_fader_level;
     sample_type _level;
+
+    std::atomic<unsigned> _dirty{0};  ///< bitmap of changed parameters
+
+    /// Position in the SourceArrays, updated in each audio cycle
+    size_t _index = 0;
+    /// Processing time in seconds (average of recent measurements)
+    float _cost = 0.0f;
 };
 
 template<typename Derived>
 void RendererBase<Derived>::Source::_process()
 {
+  // Sources are processed by the worker threads, too
+  if (this->parent._thread_layout.setup_worker_thread())
+  {
+    rtcheck::mark_realtime_thread();
+  }
+
 #ifdef ENABLE_DYNAMIC_ASDF
   if (_input == nullptr)
   {
@@ -792,46 +1524,13 @@ void RendererBase<Derived>::Source::_process()
   }
 #endif
 
-  if (!this->parent.state.processing || this->mute || !this->active)
+  // This has been computed for all sources in Process
+  this->weighting_factor = this->parent._source_arrays.get()->weight[_index];
+
   {
-    this->weighting_factor = 0.0;
+    StageTimer::Scope timer(this->parent._stage_timer, StageTimer::metering);
+    _level_helper(this->parent);
   }
-  else
-  {
-    this->weighting_factor = this->gain;
-    // If the renderer does something nonlinear, the master volume should
-    // be applied to the output signal ... TODO: shall we care?
-    this->weighting_factor *= this->parent.state.master_volume;
-    this->weighting_factor *= this->parent.master_volume_correction;
-
-    // apply distance attenuation
-    if (std::strcmp(this->parent.name(), "BrsRenderer") != 0
-         && std::strcmp(this->parent.name(), "GenericRenderer") != 0)
-    {
-      if (this->model != "plane")
-      {
-        float source_distance = length(vec3{this->position}
-          - (vec3{this->parent.state.reference_position}
-            + vec3{this->parent.state.reference_position_offset}));
-
-        // no volume increase for sources closer than 0.5 m
-        source_distance = std::max(source_distance, 0.5f);
-
-       // standard 1/r: weight *= 1.0f / source_distance;
-       this->weighting_factor *= 1.0f
-         / pow(source_distance, this->parent.state.decay_exponent); // 1/r^e
-
-       // plane wave always have the same amplitude independent of the amplitude
-       // reference distance and the decay exponent; normalize all other sources
-       // accordingly
-       this->weighting_factor *=
-         pow(this->parent.state.amplitude_reference_distance,
-           this->parent.state.decay_exponent);
-      } // if model::plane
-    } // if != BRS or Generic
-  } // if muted or not
-
-  _level_helper(this->parent);
 
   assert(this->weighting_factor.exactly_one_assignment());
 }
@@ -847,15 +1546,28 @@ class RendererBase<Derived>::Output : public _base::Output
 
     struct Process : _base::Output::Process
     {
-      explicit Process(Output& o) : _base::Output::Process(o) , _out(o) {}
+      explicit Process(Output& o) : _base::Output::Process(o) , _out(o)
+      {
+        if (o.parent._thread_layout.setup_worker_thread())
+        {
+          rtcheck::mark_realtime_thread();
+        }
+        _start = o.parent._stage_timer.start();
+      }
 
       ~Process()
       {
-        _out._level_helper(_out.parent);
+        auto& timer = _out.parent._stage_timer;
+        {
+          StageTimer::Scope scope(timer, StageTimer::metering);
+          _out._level_helper(_out.parent);
+        }
+        timer.stop(StageTimer::outputs, _start);
       }
 
       private:
         Output& _out;
+        StageTimer::ticks_t _start;
     };
 
     sample_type get_level() const { return _level; }
@@ -882,7 +1594,8 @@ struct SourceToOutput : Base<Derived>
   struct Source : Base<Derived>::Source
   {
     using typename Base<Derived>::Source::Params;
-    using sourcechannels_t = apf::fixed_vector<typename Derived::SourceChannel>;
+    using sourcechannels_t = apf::fixed_vector<typename Derived::SourceChannel
+      , SourceArenaAllocator<typename Derived::SourceChannel>>;
 
     template<typename... Args>
     Source(const Params& p, Args&&... args)
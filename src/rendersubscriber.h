@@ -135,7 +135,8 @@ private:
 
   void source_model(id_t id, const std::string& model) override
   {
-    _set_source_member(id, &Source::model, model);
+    // NB: The string is converted here, not in the audio thread
+    _set_source_member(id, &Source::model, to_source_model(model));
   }
 
   void source_fixed(id_t, bool) override
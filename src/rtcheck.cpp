@@ -0,0 +1,237 @@
+/******************************************************************************
+ * Copyright © 2019 SSR Contributors                                          *
+ *                                                                            *
+ * This file is part of the SoundScape Renderer (SSR).                        *
+ *                                                                            *
+ * The SSR is free software:  you can redistribute it and/or modify it  under *
+ * the terms of the  GNU  General  Public  License  as published by the  Free *
+ * Software Foundation, either version 3 of the License,  or (at your option) *
+ * any later version.                                                         *
+ *                                                                            *
+ * The SSR is distributed in the hope that it will be useful, but WITHOUT ANY *
+ * WARRANTY;  without even the implied warranty of MERCHANTABILITY or FITNESS *
+ * FOR A PARTICULAR PURPOSE.                                                  *
+ * See the GNU General Public License for more details.                       *
+ *                                                                            *
+ * You should  have received a copy  of the GNU General Public License  along *
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                            *
+ * The SSR is a tool  for  real-time  spatial audio reproduction  providing a *
+ * variety of rendering algorithms.                                           *
+ *                                                                            *
+ * http://spatialaudio.net/ssr                           ssr@spatialaudio.net *
+ ******************************************************************************/
+
+/// @file
+/// Replacements for realtime-unsafe functions (see rtcheck.h).
+///
+/// The functions are replaced by symbol interposition, which only works with
+/// glibc (the originals are obtained via __libc_malloc() etc. and dlsym()).
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>  // for ENABLE_RTCHECK
+#endif
+
+#ifdef ENABLE_RTCHECK
+
+#include <dlfcn.h>  // for dlsym()
+#include <execinfo.h>  // for backtrace()
+#include <pthread.h>
+#include <unistd.h>  // for write(), usleep(), sleep()
+#include <atomic>
+#include <cerrno>  // for ENOMEM
+#include <cstdlib>  // for std::abort(), std::getenv()
+#include <cstring>  // for std::strlen(), std::strcmp()
+#include <ctime>  // for nanosleep(), clock_nanosleep()
+
+#include "rtcheck.h"
+
+extern "C"
+{
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t number, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+}
+
+namespace
+{
+
+thread_local bool realtime_thread = false;
+// Avoid reporting calls made while reporting (e.g. by backtrace())
+thread_local bool reporting = false;
+
+std::atomic<size_t> violation_count{0};
+std::atomic<bool> abort_on_violation{true};
+
+void write_message(const char* message)
+{
+  // NB: write() is not replaced, therefore there is no recursion
+  auto ignored = write(STDERR_FILENO, message, std::strlen(message));
+  (void)ignored;
+}
+
+/// Report @p function if it is called from a realtime thread.
+/// Only async-signal-safe functions are used, because we may be in malloc().
+void check(const char* function)
+{
+  if (!realtime_thread || reporting)
+  {
+    return;
+  }
+  reporting = true;
+  ++violation_count;
+
+  write_message("SSR rtcheck: ");
+  write_message(function);
+  write_message("() called from realtime thread\n");
+
+  void* frames[64];
+  int size = backtrace(frames, 64);
+  backtrace_symbols_fd(frames, size, STDERR_FILENO);
+
+  if (abort_on_violation)
+  {
+    std::abort();
+  }
+  reporting = false;
+}
+
+/// Get the original function @p name (which is looked up only once).
+template<typename F>
+F* original(F*& function, const char* name)
+{
+  if (!function)
+  {
+    function = reinterpret_cast<F*>(dlsym(RTLD_NEXT, name));
+  }
+  return function;
+}
+
+using mutex_lock_t = int(pthread_mutex_t*);
+using nanosleep_t = int(const timespec*, timespec*);
+using clock_nanosleep_t = int(clockid_t, int, const timespec*, timespec*);
+using usleep_t = int(useconds_t);
+using sleep_t = unsigned int(unsigned int);
+
+mutex_lock_t* original_mutex_lock = nullptr;
+nanosleep_t* original_nanosleep = nullptr;
+clock_nanosleep_t* original_clock_nanosleep = nullptr;
+usleep_t* original_usleep = nullptr;
+sleep_t* original_sleep = nullptr;
+
+/// Look up all original functions at startup, because dlsym() may allocate.
+struct Init
+{
+  Init()
+  {
+    original(original_mutex_lock, "pthread_mutex_lock");
+    original(original_nanosleep, "nanosleep");
+    original(original_clock_nanosleep, "clock_nanosleep");
+    original(original_usleep, "usleep");
+    original(original_sleep, "sleep");
+
+    const char* mode = std::getenv("SSR_RTCHECK");
+    if (mode && std::strcmp(mode, "log") == 0)
+    {
+      abort_on_violation = false;
+    }
+  }
+} init;
+
+}  // unnamed namespace
+
+namespace ssr
+{
+
+namespace rtcheck
+{
+
+void mark_realtime_thread() { realtime_thread = true; }
+void unmark_realtime_thread() { realtime_thread = false; }
+void set_abort(bool abort) { abort_on_violation = abort; }
+size_t violations() { return violation_count; }
+
+}  // namespace rtcheck
+
+}  // namespace ssr
+
+extern "C"
+{
+
+void* malloc(size_t size)
+{
+  check("malloc");
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t number, size_t size)
+{
+  check("calloc");
+  return __libc_calloc(number, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+  check("realloc");
+  return __libc_realloc(ptr, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size)
+{
+  check("posix_memalign");
+  *ptr = __libc_memalign(alignment, size);
+  return *ptr ? 0 : ENOMEM;
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+  check("aligned_alloc");
+  return __libc_memalign(alignment, size);
+}
+
+void free(void* ptr)
+{
+  if (ptr)
+  {
+    check("free");
+  }
+  __libc_free(ptr);
+}
+
+int pthread_mutex_lock(pthread_mutex_t* mutex)
+{
+  check("pthread_mutex_lock");
+  return original(original_mutex_lock, "pthread_mutex_lock")(mutex);
+}
+
+int nanosleep(const timespec* request, timespec* remaining)
+{
+  check("nanosleep");
+  return original(original_nanosleep, "nanosleep")(request, remaining);
+}
+
+int clock_nanosleep(clockid_t clock, int flags, const timespec* request
+    , timespec* remaining)
+{
+  check("clock_nanosleep");
+  return original(original_clock_nanosleep, "clock_nanosleep")(
+      clock, flags, request, remaining);
+}
+
+int usleep(useconds_t microseconds)
+{
+  check("usleep");
+  return original(original_usleep, "usleep")(microseconds);
+}
+
+unsigned int sleep(unsigned int seconds)
+{
+  check("sleep");
+  return original(original_sleep, "sleep")(seconds);
+}
+
+}  // extern "C"
+
+#endif
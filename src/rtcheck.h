@@ -0,0 +1,74 @@
+/******************************************************************************
+ * Copyright © 2019 SSR Contributors                                          *
+ *                                                                            *
+ * This file is part of the SoundScape Renderer (SSR).                        *
+ *                                                                            *
+ * The SSR is free software:  you can redistribute it and/or modify it  under *
+ * the terms of the  GNU  General  Public  License  as published by the  Free *
+ * Software Foundation, either version 3 of the License,  or (at your option) *
+ * any later version.                                                         *
+ *                                                                            *
+ * The SSR is distributed in the hope that it will be useful, but WITHOUT ANY *
+ * WARRANTY;  without even the implied warranty of MERCHANTABILITY or FITNESS *
+ * FOR A PARTICULAR PURPOSE.                                                  *
+ * See the GNU General Public License for more details.                       *
+ *                                                                            *
+ * You should  have received a copy  of the GNU General Public License  along *
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                            *
+ * The SSR is a tool  for  real-time  spatial audio reproduction  providing a *
+ * variety of rendering algorithms.                                           *
+ *                                                                            *
+ * http://spatialaudio.net/ssr                           ssr@spatialaudio.net *
+ ******************************************************************************/
+
+/// @file
+/// Checks for realtime-unsafe function calls in the audio threads.
+///
+/// If the SSR is configured with --enable-rtcheck, rtcheck.cpp replaces
+/// malloc(), free(), pthread_mutex_lock(), nanosleep() and a few more.
+/// When one of them is called from a thread which was marked as realtime
+/// thread, a backtrace is printed and the program is aborted.
+/// With the environment variable SSR_RTCHECK=log, it continues instead.
+///
+/// Without --enable-rtcheck, all functions in this file do nothing.
+
+#ifndef SSR_RTCHECK_H
+#define SSR_RTCHECK_H
+
+#include <cstddef>  // for size_t
+
+namespace ssr
+{
+
+namespace rtcheck
+{
+
+#ifdef ENABLE_RTCHECK
+
+/// Mark the calling thread as realtime thread.
+/// This is called by the renderers at the beginning of each audio cycle
+/// (and once in each worker thread, when it processes its first Source or
+/// Output).
+void mark_realtime_thread();
+/// Undo mark_realtime_thread(), e.g. after calling audio_callback() manually.
+void unmark_realtime_thread();
+/// Abort on violations (default) or only count and report them?
+void set_abort(bool abort);
+/// Number of realtime-unsafe calls so far (in all threads).
+size_t violations();
+
+#else
+
+inline void mark_realtime_thread() {}
+inline void unmark_realtime_thread() {}
+inline void set_abort(bool) {}
+inline size_t violations() { return 0; }
+
+#endif
+
+}  // namespace rtcheck
+
+}  // namespace ssr
+
+#endif
@@ -0,0 +1,283 @@
+/******************************************************************************
+ * Copyright © 2019 SSR Contributors                                          *
+ *                                                                            *
+ * This file is part of the SoundScape Renderer (SSR).                        *
+ *                                                                            *
+ * The SSR is free software:  you can redistribute it and/or modify it  under *
+ * the terms of the  GNU  General  Public  License  as published by the  Free *
+ * Software Foundation, either version 3 of the License,  or (at your option) *
+ * any later version.                                                         *
+ *                                                                            *
+ * The SSR is distributed in the hope that it will be useful, but WITHOUT ANY *
+ * WARRANTY;  without even the implied warranty of MERCHANTABILITY or FITNESS *
+ * FOR A PARTICULAR PURPOSE.                                                  *
+ * See the GNU General Public License for more details.                       *
+ *                                                                            *
+ * You should  have received a copy  of the GNU General Public License  along *
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                            *
+ * The SSR is a tool  for  real-time  spatial audio reproduction  providing a *
+ * variety of rendering algorithms.                                           *
+ *                                                                            *
+ * http://spatialaudio.net/ssr                           ssr@spatialaudio.net *
+ ******************************************************************************/
+
+/// @file
+/// Slab allocator for the DSP state of sources.
+
+#ifndef SSR_SOURCEARENA_H
+#define SSR_SOURCEARENA_H
+
+#include <algorithm>  // for std::max()
+#include <cassert>
+#include <cstddef>  // for std::max_align_t
+#include <mutex>
+#include <new>  // for std::bad_alloc, std::align_val_t
+
+#ifdef __linux__
+#include <sys/mman.h>  // for madvise()
+#endif
+
+namespace ssr
+{
+
+/** Memory for the DSP state of sources, allocated in large slabs.
+ * Normally, each source object, its SourceChannel%s etc. are separate heap
+ * allocations, spread over the whole heap.  With a SourceArena, they are
+ * placed next to each other, in the order they are created.  All sources
+ * created together (e.g. when loading a scene) end up in contiguous memory,
+ * which reduces cache and TLB misses when they are processed.
+ *
+ * Memory is only taken from the arena while a Scope is active in the
+ * calling thread, otherwise the normal heap is used.  Memory is given back
+ * with deallocate(), which can be called from any non-realtime thread
+ * (sources are deleted by the cleanup of the command queue).  A slab is
+ * freed when all its allocations have been given back.
+ *
+ * Each allocation has a small header which points to its slab.
+ *
+ * With huge pages, the slab size is at least one huge page, and slabs of
+ * that size are aligned to a huge page and marked for transparent huge
+ * pages.  The slabs are dedicated DSP memory, therefore this can safely be
+ * done while the audio is running.
+ **/
+class SourceArena
+{
+  public:
+    /// Alignment of all allocations
+    static constexpr size_t alignment = alignof(std::max_align_t);
+
+    /// Size (and alignment) of a transparent huge page on x86-64 and ARM64
+    static constexpr size_t huge_page_size = 2 * 1024 * 1024;
+
+    /// Allocate from @p arena in the current thread (until destruction).
+    class Scope
+    {
+      public:
+        explicit Scope(SourceArena& arena)
+          : _previous(_current())
+        {
+          _current() = &arena;
+        }
+
+        ~Scope() { _current() = _previous; }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+      private:
+        SourceArena* _previous;
+    };
+
+    /// @param slab_size Size of each slab in bytes, 0 means no arena is used
+    /// @param huge_pages Use transparent huge pages for the slabs
+    explicit SourceArena(size_t slab_size, bool huge_pages = false)
+      : _slab_size(huge_pages && slab_size > 0
+          ? std::max(slab_size, huge_page_size) : slab_size)
+      , _huge_pages(huge_pages)
+    {}
+
+    ~SourceArena()
+    {
+      // All allocations should have been given back by now, otherwise the
+      // slab is leaked
+      assert(_current_slab == nullptr || _current_slab->live == 0);
+      if (_current_slab && _current_slab->live == 0) _free_slab(_current_slab);
+    }
+
+    SourceArena(const SourceArena&) = delete;
+    SourceArena& operator=(const SourceArena&) = delete;
+
+    /// Allocate from the arena of the active Scope (or from the heap).
+    static void* allocate(size_t size)
+    {
+      auto* arena = _current();
+      if (arena == nullptr || arena->_slab_size == 0)
+      {
+        auto* header = static_cast<Header*>(::operator new(
+              sizeof(Header) + size, std::align_val_t{alignment}));
+        header->slab = nullptr;
+        return header + 1;
+      }
+      return arena->_allocate(size);
+    }
+
+    /// Give back memory obtained with allocate().
+    static void deallocate(void* ptr) noexcept
+    {
+      if (ptr == nullptr) return;
+      auto* header = static_cast<Header*>(ptr) - 1;
+      if (header->slab == nullptr)
+      {
+        ::operator delete(header, std::align_val_t{alignment});
+        return;
+      }
+      header->slab->arena->_release(header->slab);
+    }
+
+    /// Number of slabs which are currently allocated (for statistics).
+    size_t slabs() const
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      return _slab_count;
+    }
+
+  private:
+    struct Slab
+    {
+      SourceArena* arena;
+      size_t size;  ///< including this header
+      size_t used;  ///< including this header
+      size_t live;  ///< number of allocations which weren't given back
+    };
+
+    struct alignas(alignment) Header
+    {
+      Slab* slab;
+    };
+
+    static_assert(sizeof(Slab) <= alignment * 2);
+
+    static constexpr size_t _round_up(size_t size)
+    {
+      return (size + alignment - 1) / alignment * alignment;
+    }
+
+    static SourceArena*& _current()
+    {
+      thread_local SourceArena* arena = nullptr;
+      return arena;
+    }
+
+    void* _allocate(size_t size)
+    {
+      auto needed = sizeof(Header) + _round_up(size);
+
+      std::lock_guard<std::mutex> lock(_mutex);
+      Slab* slab = _current_slab;
+      if (needed > _slab_size / 4)
+      {
+        // Large allocations get their own slab
+        slab = _new_slab(_round_up(sizeof(Slab)) + needed);
+      }
+      else if (slab == nullptr || slab->used + needed > slab->size)
+      {
+        if (slab && slab->live == 0) _free_slab(slab);
+        slab = _current_slab = _new_slab(_slab_size);
+      }
+      auto* header = reinterpret_cast<Header*>(
+          reinterpret_cast<char*>(slab) + slab->used);
+      header->slab = slab;
+      slab->used += needed;
+      ++slab->live;
+      return header + 1;
+    }
+
+    void _release(Slab* slab) noexcept
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      assert(slab->live > 0);
+      if (--slab->live > 0) return;
+      if (slab == _current_slab)
+      {
+        // Start over, the memory is probably still cached
+        slab->used = _round_up(sizeof(Slab));
+      }
+      else
+      {
+        _free_slab(slab);
+      }
+    }
+
+    /// Only slabs which can hold at least one huge page are aligned to it
+    size_t _slab_alignment(size_t size) const
+    {
+      return _huge_pages && size >= huge_page_size ? huge_page_size : alignment;
+    }
+
+    Slab* _new_slab(size_t size)
+    {
+      auto* slab = static_cast<Slab*>(
+          ::operator new(size, std::align_val_t{_slab_alignment(size)}));
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+      if (_slab_alignment(size) == huge_page_size)
+      {
+        // Only whole huge pages can be used, failure is not an error
+        madvise(slab, size / huge_page_size * huge_page_size, MADV_HUGEPAGE);
+      }
+#endif
+      slab->arena = this;
+      slab->size = size;
+      slab->used = _round_up(sizeof(Slab));
+      slab->live = 0;
+      ++_slab_count;
+      return slab;
+    }
+
+    void _free_slab(Slab* slab) noexcept
+    {
+      if (slab == _current_slab) _current_slab = nullptr;
+      ::operator delete(slab, std::align_val_t{_slab_alignment(slab->size)});
+      --_slab_count;
+    }
+
+    const size_t _slab_size;
+    const bool _huge_pages;
+    mutable std::mutex _mutex;
+    Slab* _current_slab = nullptr;
+    size_t _slab_count = 0;
+};
+
+/// Standard allocator which uses the SourceArena of the active Scope.
+/// Containers using this allocator must not grow in the realtime thread.
+template<typename T>
+struct SourceArenaAllocator
+{
+  static_assert(alignof(T) <= SourceArena::alignment);
+
+  using value_type = T;
+
+  SourceArenaAllocator() = default;
+  template<typename U>
+  SourceArenaAllocator(const SourceArenaAllocator<U>&) {}
+
+  T* allocate(size_t n)
+  {
+    return static_cast<T*>(SourceArena::allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T* ptr, size_t) noexcept
+  {
+    SourceArena::deallocate(ptr);
+  }
+
+  // All instances are interchangeable
+  template<typename U>
+  bool operator==(const SourceArenaAllocator<U>&) const { return true; }
+  template<typename U>
+  bool operator!=(const SourceArenaAllocator<U>&) const { return false; }
+};
+
+}  // namespace ssr
+
+#endif
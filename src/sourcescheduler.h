@@ -0,0 +1,192 @@
+/******************************************************************************
+ * Copyright © 2019 SSR Contributors                                          *
+ *                                                                            *
+ * This file is part of the SoundScape Renderer (SSR).                        *
+ *                                                                            *
+ * The SSR is free software:  you can redistribute it and/or modify it  under *
+ * the terms of the  GNU  General  Public  License  as published by the  Free *
+ * Software Foundation, either version 3 of the License,  or (at your option) *
+ * any later version.                                                         *
+ *                                                                            *
+ * The SSR is distributed in the hope that it will be useful, but WITHOUT ANY *
+ * WARRANTY;  without even the implied warranty of MERCHANTABILITY or FITNESS *
+ * FOR A PARTICULAR PURPOSE.                                                  *
+ * See the GNU General Public License for more details.                       *
+ *                                                                            *
+ * You should  have received a copy  of the GNU General Public License  along *
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                            *
+ * The SSR is a tool  for  real-time  spatial audio reproduction  providing a *
+ * variety of rendering algorithms.                                           *
+ *                                                                            *
+ * http://spatialaudio.net/ssr                           ssr@spatialaudio.net *
+ ******************************************************************************/
+
+/// @file
+/// Cost-aware dynamic scheduling of sources on the audio threads.
+
+#ifndef SSR_SOURCESCHEDULER_H
+#define SSR_SOURCESCHEDULER_H
+
+#include <algorithm>  // for std::sort()
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>  // for uint64_t
+#include <vector>
+
+#include "threadindex.h"
+
+namespace ssr
+{
+
+/** Dynamic scheduling of the items of one list, ordered by cost.
+ * apf::MimoProcessor assigns list items to its threads in a fixed pattern.
+ * If the items have very different costs, some threads finish early and the
+ * audio callback waits for the slowest one.
+ *
+ * With this scheduler, the first call to process() on any thread processes
+ * items from a shared queue until it is empty, all later calls return
+ * immediately.  Threads which are done with their work take over items
+ * which would have been processed by busier threads ("work stealing").
+ * The queue is sorted by the cost of each item in recent blocks, most
+ * expensive first, which keeps the remaining pieces of work small towards
+ * the end of the block.
+ *
+ * Additionally, a number of "extra" items can be processed in the same way
+ * (before the sources), e.g. output items of the previous block in the
+ * pipelined mode of the WFS renderer.
+ *
+ * The costs are measured every few blocks (see measuring()).
+ * For each thread, the time spent processing items is accumulated, see
+ * utilization().
+ **/
+class SourceScheduler
+{
+  public:
+    using clock = std::chrono::steady_clock;
+
+    /// Threads beyond this number are counted as the last one
+    static constexpr size_t max_threads = 32;
+
+    /// Costs are measured every measure_interval blocks
+    static constexpr unsigned measure_interval = 8;
+
+    /// @param block_duration Duration of one audio block in seconds
+    explicit SourceScheduler(double block_duration)
+      : _block_duration(block_duration)
+    {}
+
+    /** Start a new block (audio main thread, before items are processed).
+     * @param order Array of @p size elements, receives the processing order
+     * @param costs Costs of the items (measured in previous blocks)
+     * @param extra Number of extra items, see run()
+     **/
+    void prepare(size_t* order, const float* costs, size_t size
+        , size_t extra = 0)
+    {
+      _measure = (++_blocks % measure_interval) == 0;
+
+      // Sorting is only needed after measuring or if the list (or the array
+      // holding the order) has changed
+      if (size != _size || order != _order || _measure)
+      {
+        for (size_t i = 0; i < size; ++i)
+        {
+          order[i] = i;
+        }
+        std::sort(order, order + size, [costs](size_t a, size_t b)
+        {
+          return costs[a] > costs[b];
+        });
+      }
+      _order = order;
+      _size = size;
+      _extra = extra;
+      _next.store(0, std::memory_order_relaxed);
+      _block_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /// Should the cost of each item be measured in the current block?
+    bool measuring() const { return _measure; }
+
+    /** Process items until the queue is empty (any audio thread).
+     * @param f Function which is called with the index of each item
+     * @param g Function which is called with the index of each extra item
+     **/
+    template<typename F, typename G>
+    void run(F&& f, G&& g)
+    {
+      auto total = _extra + _size;
+      size_t i = _next.fetch_add(1, std::memory_order_relaxed);
+      if (i >= total)
+      {
+        return;
+      }
+      auto start = clock::now();
+      do
+      {
+        if (i < _extra)
+        {
+          g(i);
+        }
+        else
+        {
+          f(_order[i - _extra]);
+        }
+      }
+      while ((i = _next.fetch_add(1, std::memory_order_relaxed)) < total);
+
+      auto busy = std::chrono::duration_cast<std::chrono::nanoseconds>(
+          clock::now() - start).count();
+      _busy[_thread_index()].fetch_add(busy, std::memory_order_relaxed);
+    }
+
+    /// Fraction of time each audio thread spent processing items, since the
+    /// start.  This can be used from any thread.
+    std::vector<float> utilization() const
+    {
+      auto result = std::vector<float>();
+      auto blocks = _block_count.load(std::memory_order_relaxed);
+      if (blocks == 0)
+      {
+        return result;
+      }
+      auto threads = std::min(_thread_ids.count(), max_threads);
+      for (size_t i = 0; i < threads; ++i)
+      {
+        result.push_back(static_cast<float>(
+              _busy[i].load(std::memory_order_relaxed)
+              / (1e9 * _block_duration * blocks)));
+      }
+      return result;
+    }
+
+  private:
+    /// A number for each thread, assigned on its first use.
+    /// NB: Threads are numbered in the order they first process an item.
+    size_t _thread_index() const
+    {
+      return std::min(_thread_ids.get(), max_threads - 1);
+    }
+
+    const double _block_duration;
+
+    // Only used by the audio main thread:
+    unsigned _blocks = 0;
+    bool _measure = false;
+
+    // Written in prepare(), read by all audio threads afterwards:
+    size_t* _order = nullptr;
+    size_t _size = 0;
+    size_t _extra = 0;
+
+    std::atomic<size_t> _next{0};
+    ThreadIndex _thread_ids;
+    std::atomic<uint64_t> _block_count{0};
+    std::array<std::atomic<uint64_t>, max_threads> _busy{};
+};
+
+}  // namespace ssr
+
+#endif
@@ -0,0 +1,194 @@
+/******************************************************************************
+ * Copyright © 2019 SSR Contributors                                          *
+ *                                                                            *
+ * This file is part of the SoundScape Renderer (SSR).                        *
+ *                                                                            *
+ * The SSR is free software:  you can redistribute it and/or modify it  under *
+ * the terms of the  GNU  General  Public  License  as published by the  Free *
+ * Software Foundation, either version 3 of the License,  or (at your option) *
+ * any later version.                                                         *
+ *                                                                            *
+ * The SSR is distributed in the hope that it will be useful, but WITHOUT ANY *
+ * WARRANTY;  without even the implied warranty of MERCHANTABILITY or FITNESS *
+ * FOR A PARTICULAR PURPOSE.                                                  *
+ * See the GNU General Public License for more details.                       *
+ *                                                                            *
+ * You should  have received a copy  of the GNU General Public License  along *
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                            *
+ * The SSR is a tool  for  real-time  spatial audio reproduction  providing a *
+ * variety of rendering algorithms.                                           *
+ *                                                                            *
+ * http://spatialaudio.net/ssr                           ssr@spatialaudio.net *
+ ******************************************************************************/
+
+/// @file
+/// Processing time of the audio callback, per stage and per thread.
+
+#ifndef SSR_STAGETIMER_H
+#define SSR_STAGETIMER_H
+
+#include <algorithm>  // for std::min()
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>  // for uint64_t
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>  // for __rdtsc()
+#endif
+
+#include "threadindex.h"
+
+namespace ssr
+{
+
+/** Accumulate the processing time of the stages of the audio callback.
+ * The audio threads add the time spent in each stage to their own counters,
+ * which are collected from time to time by the control thread, see collect().
+ * If disabled, start() and stop() do nothing except checking a flag.
+ *
+ * Times are measured with the time stamp counter of the CPU (if available),
+ * loads are computed relative to the same counter on the control thread,
+ * therefore no calibration is needed.
+ *
+ * Stages can be nested (e.g. metering is also part of sources and outputs).
+ **/
+class StageTimer
+{
+  public:
+    enum stage_t
+    {
+      inputs,  ///< input processing (e.g. WFS pre-filter)
+      prepare,  ///< parameter updates, gain computation (main thread only)
+      sources,  ///< source processing, including input FFTs and metering
+      combine,  ///< combination of sources (in outputs or separate items)
+      outputs,  ///< output processing, including combination and metering
+      metering,  ///< level metering of sources and outputs
+      stage_count
+    };
+
+    /// Threads beyond this number share the counters of the last one
+    static constexpr size_t max_threads = 32;
+
+    using ticks_t = uint64_t;
+
+    /// Measure the time between construction and destruction.
+    class Scope
+    {
+      public:
+        Scope(const StageTimer& timer, stage_t stage)
+          : _timer(timer)
+          , _stage(stage)
+          , _start(timer.start())
+        {}
+
+        ~Scope() { _timer.stop(_stage, _start); }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+      private:
+        const StageTimer& _timer;
+        stage_t _stage;
+        ticks_t _start;
+    };
+
+    explicit StageTimer(bool enabled)
+      : _enabled(enabled)
+      , _last_collect(now())
+    {}
+
+    bool enabled() const { return _enabled; }
+
+    static const char* name(size_t stage)
+    {
+      static const char* names[stage_count] = { "inputs", "prepare"
+        , "sources", "combine", "outputs", "metering" };
+      return stage < stage_count ? names[stage] : "";
+    }
+
+    static ticks_t now()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+      return __rdtsc();
+#else
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    /// Start measuring (any audio thread).
+    ticks_t start() const
+    {
+      return _enabled ? now() : 0;
+    }
+
+    /// Add the time since @p start to @p stage (any audio thread).
+    void stop(stage_t stage, ticks_t start) const
+    {
+      if (!_enabled) return;
+      auto index = _thread_ids.get();
+      if (index >= max_threads - 1)
+      {
+        // The last counters are shared by all remaining threads
+        _threads[max_threads - 1].ticks[stage].fetch_add(now() - start
+            , std::memory_order_relaxed);
+        return;
+      }
+      auto& counter = _threads[index].ticks[stage];
+      // Each other counter is only written by one thread
+      counter.store(counter.load(std::memory_order_relaxed) + (now() - start)
+          , std::memory_order_relaxed);
+    }
+
+    /** Get the loads since the previous call (control thread).
+     * @param[out] loads For each stage, the load of each thread in percent
+     *   (i.e. time spent in the stage relative to the elapsed time).
+     *   Threads are numbered in the order they first finish a stage.
+     **/
+    void collect(std::vector<std::vector<float>>& loads)
+    {
+      auto current = now();
+      auto elapsed = static_cast<float>(current - _last_collect);
+      _last_collect = current;
+
+      auto threads = std::min(_thread_ids.count(), max_threads);
+      loads.resize(stage_count);
+      for (size_t stage = 0; stage < stage_count; ++stage)
+      {
+        loads[stage].resize(threads);
+        for (size_t thread = 0; thread < threads; ++thread)
+        {
+          auto total = _threads[thread].ticks[stage].load(
+              std::memory_order_relaxed);
+          auto& previous = _previous[thread][stage];
+          loads[stage][thread] = elapsed > 0
+            ? 100.0f * static_cast<float>(total - previous) / elapsed : 0.0f;
+          previous = total;
+        }
+      }
+    }
+
+  private:
+    // One cache line (or more) per thread, to avoid false sharing
+    struct alignas(64) ThreadTicks
+    {
+      std::array<std::atomic<ticks_t>, stage_count> ticks{};
+    };
+
+    const bool _enabled;
+
+    // NB: These are only statistics, they can be changed in const functions
+    mutable std::array<ThreadTicks, max_threads> _threads{};
+    ThreadIndex _thread_ids;
+
+    // Only used by the control thread:
+    ticks_t _last_collect;
+    std::array<std::array<ticks_t, stage_count>, max_threads> _previous{};
+};
+
+}  // namespace ssr
+
+#endif
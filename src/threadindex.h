@@ -0,0 +1,135 @@
+/******************************************************************************
+ * Copyright © 2019 SSR Contributors                                          *
+ *                                                                            *
+ * This file is part of the SoundScape Renderer (SSR).                        *
+ *                                                                            *
+ * The SSR is free software:  you can redistribute it and/or modify it  under *
+ * the terms of the  GNU  General  Public  License  as published by the  Free *
+ * Software Foundation, either version 3 of the License,  or (at your option) *
+ * any later version.                                                         *
+ *                                                                            *
+ * The SSR is distributed in the hope that it will be useful, but WITHOUT ANY *
+ * WARRANTY;  without even the implied warranty of MERCHANTABILITY or FITNESS *
+ * FOR A PARTICULAR PURPOSE.                                                  *
+ * See the GNU General Public License for more details.                       *
+ *                                                                            *
+ * You should  have received a copy  of the GNU General Public License  along *
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                            *
+ * The SSR is a tool  for  real-time  spatial audio reproduction  providing a *
+ * variety of rendering algorithms.                                           *
+ *                                                                            *
+ * http://spatialaudio.net/ssr                           ssr@spatialaudio.net *
+ ******************************************************************************/
+
+/// @file
+/// Numbering of the threads which use an object.
+
+#ifndef SSR_THREADINDEX_H
+#define SSR_THREADINDEX_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>  // for size_t
+#include <cstdint>  // for uint64_t
+
+namespace ssr
+{
+
+/** Assigns a number to each thread which uses an object.
+ * The numbers are 0, 1, 2, ... in the order in which the threads call get()
+ * for the first time.  They are stored in thread-local slots.  Each
+ * ThreadIndex has a unique generation number which identifies its slots, so
+ * a new object never sees the numbers of an old object, even if it is
+ * created at the same address.
+ *
+ * A thread can keep the numbers of a few objects at the same time.  If it
+ * uses more objects (in alternation), the oldest slot is re-used and the
+ * thread gets a new number when it comes back to that object.
+ *
+ * get() doesn't allocate memory and doesn't block, it can be used in the
+ * realtime threads.
+ **/
+class ThreadIndex
+{
+  public:
+    /// Number of objects per thread whose numbers are kept at the same time
+    static constexpr size_t slot_count = 8;
+
+    ThreadIndex()
+      : _generation(_next_generation())
+    {}
+
+    ThreadIndex(const ThreadIndex&) = delete;
+    ThreadIndex& operator=(const ThreadIndex&) = delete;
+
+    /// Number of the calling thread.
+    size_t get() const
+    {
+      bool first;
+      return get(first);
+    }
+
+    /// Number of the calling thread.
+    /// @param[out] first @c true on the first call in the calling thread
+    size_t get(bool& first) const
+    {
+      auto& local = _local();
+      for (auto& slot: local.slots)
+      {
+        if (slot.generation == _generation)
+        {
+          first = false;
+          return slot.index;
+        }
+      }
+      auto& slot = local.slots[local.next];
+      local.next = (local.next + 1) % slot_count;
+      slot.generation = _generation;
+      slot.index = _count.fetch_add(1, std::memory_order_relaxed);
+      first = true;
+      return slot.index;
+    }
+
+    /// Number of threads which have called get() so far.
+    /// This can be used from any thread.
+    size_t count() const
+    {
+      return _count.load(std::memory_order_relaxed);
+    }
+
+    /// Unique number of this object (never 0), e.g. for a thread-local cache.
+    uint64_t generation() const { return _generation; }
+
+  private:
+    struct Slot
+    {
+      uint64_t generation = 0;  // 0 means unused
+      size_t index = 0;
+    };
+
+    struct Local
+    {
+      std::array<Slot, slot_count> slots{};
+      size_t next = 0;
+    };
+
+    static Local& _local()
+    {
+      thread_local Local local;
+      return local;
+    }
+
+    static uint64_t _next_generation()
+    {
+      static std::atomic<uint64_t> generation{0};
+      return generation.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    const uint64_t _generation;
+    mutable std::atomic<size_t> _count{0};
+};
+
+}  // namespace ssr
+
+#endif
@@ -0,0 +1,401 @@
+/******************************************************************************
+ * Copyright © 2019 SSR Contributors                                          *
+ *                                                                            *
+ * This file is part of the SoundScape Renderer (SSR).                        *
+ *                                                                            *
+ * The SSR is free software:  you can redistribute it and/or modify it  under *
+ * the terms of the  GNU  General  Public  License  as published by the  Free *
+ * Software Foundation, either version 3 of the License,  or (at your option) *
+ * any later version.                                                         *
+ *                                                                            *
+ * The SSR is distributed in the hope that it will be useful, but WITHOUT ANY *
+ * WARRANTY;  without even the implied warranty of MERCHANTABILITY or FITNESS *
+ * FOR A PARTICULAR PURPOSE.                                                  *
+ * See the GNU General Public License for more details.                       *
+ *                                                                            *
+ * You should  have received a copy  of the GNU General Public License  along *
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                            *
+ * The SSR is a tool  for  real-time  spatial audio reproduction  providing a *
+ * variety of rendering algorithms.                                           *
+ *                                                                            *
+ * http://spatialaudio.net/ssr                           ssr@spatialaudio.net *
+ ******************************************************************************/
+
+/// @file
+/// CPU affinity, realtime priority and NUMA placement of the audio threads.
+
+#ifndef SSR_THREADLAYOUT_H
+#define SSR_THREADLAYOUT_H
+
+#include <algorithm>  // for std::find()
+#include <array>
+#include <atomic>
+#include <cstring>  // for std::strerror()
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <cerrno>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>  // for SYS_set_mempolicy
+#include <unistd.h>  // for syscall()
+#include <linux/mempolicy.h>  // for MPOL_PREFERRED
+#endif
+
+#include "apf/parameter_map.h"
+#include "apf/stringtools.h"  // for apf::str::A2S(), apf::str::S2A()
+
+#include "threadindex.h"
+
+namespace ssr
+{
+
+/** Placement of the worker threads of apf::MimoProcessor.
+ * The worker threads are created by apf::MimoProcessor, therefore each one
+ * is set up by itself, the first time it calls setup_worker_thread().
+ * This happens only once per thread, the system calls involved are not
+ * realtime-safe, but they are cheap.  Later calls only compare a
+ * thread-local number.
+ *
+ * A thread remembers that it has been set up in a ThreadIndex slot.  If it
+ * serves more than ThreadIndex::slot_count such objects in alternation
+ * (i.e. more than two renderers, which also use ThreadIndex for StageTimer
+ * and SourceScheduler), the slot can be evicted.  Therefore, the threads
+ * which have been set up are also recorded (by thread ID), they are never
+ * set up twice.
+ *
+ * Parameters:
+ * - @b thread_cpus: list of CPUs like "2-9,12", each worker thread is pinned
+ *   to one of them (round-robin)
+ * - @b thread_priority: SCHED_FIFO priority of the worker threads relative
+ *   to the audio main thread (i.e. the JACK thread), e.g. "-1"
+ * - @b numa_node: all audio threads and DSP memory are placed on this NUMA
+ *   node.  If no @b thread_cpus are given, worker threads may run on any
+ *   CPU of the node.
+ *
+ * The memory policy of the thread which creates the ThreadLayout (the
+ * control thread, which allocates all DSP state) is set as well.
+ **/
+class ThreadLayout
+{
+  public:
+    static constexpr size_t max_threads = 32;
+
+    explicit ThreadLayout(const apf::parameter_map& params)
+      : _cpus(parse_cpu_list(params.get("thread_cpus", "")))
+      , _numa_node(params.get("numa_node", -1))
+    {
+      auto priority = params.get("thread_priority", "");
+      _set_priority = !priority.empty()
+        && apf::str::S2A(priority, _priority_offset);
+
+      if (_numa_node >= 0)
+      {
+        _node_cpus = parse_cpu_list(_read_line("/sys/devices/system/node/node"
+              + apf::str::A2S(_numa_node) + "/cpulist"));
+        if (_node_cpus.empty() || _numa_node >= 64)
+        {
+          _error = "NUMA node " + apf::str::A2S(_numa_node) + " not found";
+          _numa_node = -1;
+        }
+        else
+        {
+          _set_memory_policy();
+        }
+      }
+    }
+
+    /// Is anything configured at all?
+    bool enabled() const
+    {
+      return !_cpus.empty() || _set_priority || _numa_node >= 0;
+    }
+
+    /// Remember the priority of the audio main thread.
+    /// This is called in each audio cycle, but it only does work once.
+    void setup_main_thread()
+    {
+      if (!_first_call()) return;
+
+#ifdef __linux__
+      int policy;
+      sched_param param;
+      if (pthread_getschedparam(pthread_self(), &policy, &param) == 0
+          && (policy == SCHED_FIFO || policy == SCHED_RR))
+      {
+        _main_priority.store(param.sched_priority, std::memory_order_release);
+      }
+#endif
+    }
+
+    /// Pin the calling worker thread, set its priority and memory policy.
+    /// This is called for each item, but it only does work once per thread.
+    /// @return @c true on the first call in the calling worker thread
+    bool setup_worker_thread()
+    {
+      // Fast path: the most recently used ThreadLayout of this thread
+      thread_local uint64_t last_generation = 0;
+      if (last_generation == _callers.generation()) return false;
+      last_generation = _callers.generation();
+
+      if (!_first_call()) return false;
+      if (!enabled() || _was_set_up()) return true;
+
+      auto index = _thread_count.fetch_add(1, std::memory_order_relaxed);
+      if (index >= max_threads) return true;
+      auto& result = _results[index];
+
+#ifdef __linux__
+      result.thread_id.store(static_cast<long>(syscall(SYS_gettid))
+          , std::memory_order_relaxed);
+      int error = 0;
+      auto cpus = _cpus_for_thread(index);
+      if (!cpus.empty())
+      {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (auto cpu: cpus) CPU_SET(cpu, &set);
+        error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (error == 0 && cpus.size() == 1)
+        {
+          result.cpu.store(cpus.front(), std::memory_order_relaxed);
+        }
+      }
+      if (error == 0 && _set_priority)
+      {
+        int main_priority = _main_priority.load(std::memory_order_acquire);
+        if (main_priority < 0)
+        {
+          error = _no_main_priority;
+        }
+        else
+        {
+          sched_param param{};
+          param.sched_priority = std::clamp(main_priority + _priority_offset
+              , sched_get_priority_min(SCHED_FIFO)
+              , sched_get_priority_max(SCHED_FIFO));
+          error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+          if (error == 0)
+          {
+            result.priority.store(param.sched_priority
+                , std::memory_order_relaxed);
+          }
+        }
+      }
+      if (error == 0 && _numa_node >= 0)
+      {
+        error = _set_memory_policy();
+      }
+      result.error.store(error, std::memory_order_relaxed);
+#endif
+      result.done.store(true, std::memory_order_release);
+      return true;
+    }
+
+    /// The configured layout, for a message at startup.
+    std::string describe() const
+    {
+      if (!enabled()) return "";
+#ifdef __linux__
+      std::string result;
+      if (!_cpus.empty())
+      {
+        result += "worker threads pinned to CPUs " + _format(_cpus) + "; ";
+      }
+      else if (_numa_node >= 0)
+      {
+        result += "worker threads on CPUs " + _format(_node_cpus) + "; ";
+      }
+      if (_numa_node >= 0)
+      {
+        result += "memory on NUMA node " + apf::str::A2S(_numa_node) + "; ";
+        for (auto cpu: _cpus)
+        {
+          if (std::find(_node_cpus.begin(), _node_cpus.end(), cpu)
+              == _node_cpus.end())
+          {
+            result += "CPU " + apf::str::A2S(cpu) + " is on another node; ";
+          }
+        }
+      }
+      if (_set_priority)
+      {
+        result += "SCHED_FIFO priority: main thread "
+          + std::string(_priority_offset < 0 ? "" : "+")
+          + apf::str::A2S(_priority_offset) + "; ";
+      }
+      if (!_error.empty())
+      {
+        result += _error + "; ";
+      }
+      return result.substr(0, result.size() - 2);
+#else
+      return "not supported on this platform";
+#endif
+    }
+
+    /// Describe worker threads which have been set up since the last call.
+    /// This can be called periodically from the control thread.
+    /// @param[out] errors receives threads which couldn't be set up.
+    std::string report(std::string& errors)
+    {
+      std::string result;
+      auto threads = std::min(_thread_count.load(std::memory_order_relaxed)
+          , max_threads);
+      for (size_t i = 0; i < threads; ++i)
+      {
+        auto& r = _results[i];
+        if (!r.done.load(std::memory_order_acquire) || r.reported) continue;
+        r.reported = true;
+
+        auto name = "worker thread " + apf::str::A2S(i + 1);
+        auto error = r.error.load(std::memory_order_relaxed);
+        if (error != 0)
+        {
+          errors += name + ": " + (error == _no_main_priority
+              ? "the audio main thread has no realtime priority"
+              : std::strerror(error)) + "\n";
+          continue;
+        }
+        result += name + ":";
+        auto cpu = r.cpu.load(std::memory_order_relaxed);
+        if (cpu >= 0) result += " CPU " + apf::str::A2S(cpu);
+        auto priority = r.priority.load(std::memory_order_relaxed);
+        if (priority >= 0) result += " priority " + apf::str::A2S(priority);
+        result += "\n";
+      }
+      return result;
+    }
+
+    /// Parse a list of CPUs (or NUMA nodes) like "0-3,8,10-11".
+    static std::vector<int> parse_cpu_list(const std::string& list)
+    {
+      auto result = std::vector<int>();
+      size_t pos = 0;
+      while (pos < list.size())
+      {
+        auto end = list.find(',', pos);
+        if (end == std::string::npos) end = list.size();
+        auto item = list.substr(pos, end - pos);
+        pos = end + 1;
+
+        int first, last;
+        auto dash = item.find('-');
+        if (dash == std::string::npos)
+        {
+          if (!apf::str::S2A(item, first)) continue;
+          last = first;
+        }
+        else if (!apf::str::S2A(item.substr(0, dash), first)
+            || !apf::str::S2A(item.substr(dash + 1), last))
+        {
+          continue;
+        }
+        for (int cpu = first; cpu <= last; ++cpu)
+        {
+          if (cpu >= 0) result.push_back(cpu);
+        }
+      }
+      return result;
+    }
+
+  private:
+    /// Error number used if the priority can't be set relative to the main
+    /// thread
+    static constexpr int _no_main_priority = -1;
+
+    /// True on the first call in the calling thread (for this instance).
+    /// NB: This can be true again after the slot was evicted, see ThreadIndex.
+    bool _first_call() const
+    {
+      bool first;
+      _callers.get(first);
+      return first;
+    }
+
+    /// Has the calling worker thread already been set up?
+    bool _was_set_up() const
+    {
+#ifdef __linux__
+      auto thread_id = static_cast<long>(syscall(SYS_gettid));
+      auto threads = std::min(_thread_count.load(std::memory_order_relaxed)
+          , max_threads);
+      for (size_t i = 0; i < threads; ++i)
+      {
+        if (_results[i].thread_id.load(std::memory_order_relaxed) == thread_id)
+        {
+          return true;
+        }
+      }
+#endif
+      return false;
+    }
+
+    std::vector<int> _cpus_for_thread(size_t index) const
+    {
+      if (!_cpus.empty()) return { _cpus[index % _cpus.size()] };
+      return _node_cpus;
+    }
+
+    /// Prefer memory of _numa_node for the calling thread.
+    /// @return 0 on success, otherwise an error number
+    int _set_memory_policy() const
+    {
+#ifdef __linux__
+      unsigned long mask = 1ul << _numa_node;
+      if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, &mask
+            , sizeof(mask) * 8 + 1) != 0)
+      {
+        return errno;
+      }
+#endif
+      return 0;
+    }
+
+    static std::string _read_line(const std::string& file_name)
+    {
+      std::string line;
+      std::ifstream file(file_name);
+      std::getline(file, line);
+      return line;
+    }
+
+    static std::string _format(const std::vector<int>& cpus)
+    {
+      std::string result;
+      for (auto cpu: cpus)
+      {
+        result += (result.empty() ? "" : ",") + apf::str::A2S(cpu);
+      }
+      return result;
+    }
+
+    struct Result
+    {
+      std::atomic<bool> done{false};
+      std::atomic<int> error{0};
+      std::atomic<int> cpu{-1};
+      std::atomic<int> priority{-1};
+      std::atomic<long> thread_id{0};  // only written by the thread itself
+      bool reported = false;  // only used by report()
+    };
+
+    const std::vector<int> _cpus;
+    std::vector<int> _node_cpus;
+    int _numa_node;
+    bool _set_priority = false;
+    int _priority_offset = 0;
+    std::string _error;
+
+    std::atomic<int> _main_priority{-1};
+    std::atomic<size_t> _thread_count{0};
+    ThreadIndex _callers;
+    std::array<Result, max_threads> _results{};
+};
+
+}  // namespace ssr
+
+#endif
@@ -0,0 +1,192 @@
+/******************************************************************************
+ * Copyright © 2019 SSR Contributors                                          *
+ *                                                                            *
+ * This file is part of the SoundScape Renderer (SSR).                        *
+ *                                                                            *
+ * The SSR is free software:  you can redistribute it and/or modify it  under *
+ * the terms of the  GNU  General  Public  License  as published by the  Free *
+ * Software Foundation, either version 3 of the License,  or (at your option) *
+ * any later version.                                                         *
+ *                                                                            *
+ * The SSR is distributed in the hope that it will be useful, but WITHOUT ANY *
+ * WARRANTY;  without even the implied warranty of MERCHANTABILITY or FITNESS *
+ * FOR A PARTICULAR PURPOSE.                                                  *
+ * See the GNU General Public License for more details.                       *
+ *                                                                            *
+ * You should  have received a copy  of the GNU General Public License  along *
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                            *
+ * The SSR is a tool  for  real-time  spatial audio reproduction  providing a *
+ * variety of rendering algorithms.                                           *
+ *                                                                            *
+ * http://spatialaudio.net/ssr                           ssr@spatialaudio.net *
+ ******************************************************************************/
+
+/// @file
+/// Triangulation of loudspeaker directions for 3D amplitude panning.
+
+#ifndef SSR_TRIANGULATION_H
+#define SSR_TRIANGULATION_H
+
+#include <algorithm>  // for std::min_element(), std::max()
+#include <array>
+#include <cmath>  // for std::sqrt()
+#include <limits>  // for std::numeric_limits
+#include <stdexcept>  // for std::logic_error
+#include <utility>  // for std::pair
+#include <vector>
+
+#include "geometry.h"  // for vec3
+
+namespace ssr
+{
+
+/// Triplet of loudspeakers on the convex hull of all loudspeaker directions.
+struct LoudspeakerTriangle
+{
+  /// Indices into the list of directions given to triangulate()
+  std::array<size_t, 3> loudspeakers;
+  /// Inverse of the matrix with the loudspeaker directions as columns,
+  /// stored in row-major order.
+  std::array<float, 9> inverse;
+
+  /// Un-normalized gains, negative if @p direction is outside.
+  std::array<float, 3> gains(const vec3& direction) const
+  {
+    std::array<float, 3> result;
+    for (size_t i = 0; i < 3; ++i)
+    {
+      result[i] = inverse[3 * i] * direction[0]
+        + inverse[3 * i + 1] * direction[1]
+        + inverse[3 * i + 2] * direction[2];
+    }
+    return result;
+  }
+};
+
+/** Find all loudspeaker triangles on the convex hull.
+ * The hull is computed from the (normalized) loudspeaker directions, i.e.
+ * points on the unit sphere.
+ * Triangles whose plane (nearly) contains the origin are dropped, e.g. the
+ * base of a hemispherical dome.
+ * The brute force approach is O(N^4), but this is only done once.
+ * @throw std::logic_error if no triangle is found.
+ **/
+inline std::vector<LoudspeakerTriangle>
+triangulate(const std::vector<vec3>& directions)
+{
+  const float epsilon = 0.0001f;
+  const size_t n = directions.size();
+
+  auto triangles = std::vector<LoudspeakerTriangle>();
+
+  for (size_t i = 0; i < n; ++i)
+  {
+    for (size_t j = i + 1; j < n; ++j)
+    {
+      for (size_t k = j + 1; k < n; ++k)
+      {
+        const auto& a = directions[i];
+        const auto& b = directions[j];
+        const auto& c = directions[k];
+
+        auto normal = gml::cross(b - a, c - a);
+        auto normal_length = gml::length(normal);
+        if (normal_length < epsilon)
+        {
+          continue;  // collinear
+        }
+        normal /= normal_length;
+        if (gml::dot(normal, a) < 0)
+        {
+          normal = -normal;
+        }
+        if (gml::dot(normal, a) < epsilon)
+        {
+          continue;  // plane contains the origin
+        }
+
+        bool on_hull = true;
+        for (size_t m = 0; m < n; ++m)
+        {
+          if (gml::dot(normal, directions[m] - a) > epsilon)
+          {
+            on_hull = false;
+            break;
+          }
+        }
+        if (!on_hull)
+        {
+          continue;
+        }
+
+        // Inverse of [a b c] via the adjugate
+        auto det = gml::dot(a, gml::cross(b, c));
+        auto rows = std::array<gml::vec3, 3>{{gml::cross(b, c) / det
+          , gml::cross(c, a) / det, gml::cross(a, b) / det}};
+
+        LoudspeakerTriangle triangle;
+        triangle.loudspeakers = {{i, j, k}};
+        for (size_t row = 0; row < 3; ++row)
+        {
+          for (size_t col = 0; col < 3; ++col)
+          {
+            triangle.inverse[3 * row + col] = rows[row][col];
+          }
+        }
+        triangles.push_back(triangle);
+      }
+    }
+  }
+
+  if (triangles.empty())
+  {
+    throw std::logic_error("No loudspeaker triangles found!");
+  }
+  return triangles;
+}
+
+/** Find the triangle for a given direction and calculate the panning gains.
+ * For directions outside of all triangles (e.g. below the lowest loudspeakers
+ * of a dome), the triangle with the least negative gain is used and negative
+ * gains are set to zero.
+ * This is O(N), it should not be used in the audio thread.
+ * @return triangle index and gains (normalized to constant power)
+ **/
+inline std::pair<size_t, std::array<float, 3>>
+find_triangle(const std::vector<LoudspeakerTriangle>& triangles
+    , const vec3& direction)
+{
+  auto result = std::pair<size_t, std::array<float, 3>>();
+  float best = -std::numeric_limits<float>::infinity();
+  for (size_t t = 0; t < triangles.size(); ++t)
+  {
+    auto gains = triangles[t].gains(direction);
+    auto min_gain = *std::min_element(gains.begin(), gains.end());
+    if (min_gain > best)
+    {
+      best = min_gain;
+      result = {t, gains};
+    }
+  }
+
+  float norm = 0;
+  for (auto& gain: result.second)
+  {
+    gain = std::max(gain, 0.0f);
+    norm += gain * gain;
+  }
+  norm = std::sqrt(norm);
+  if (norm > 0)
+  {
+    for (auto& gain: result.second)
+    {
+      gain /= norm;
+    }
+  }
+  return result;
+}
+
+}  // namespace ssr
+
+#endif
@@ -30,8 +30,15 @@
 #ifndef SSR_VBAPRENDERER_H
 #define SSR_VBAPRENDERER_H
 
+#include <algorithm>  // for std::min_element()
+#include <array>
+#include <cmath>  // for std::atan2(), std::hypot(), std::sqrt()
+#include <tuple>  // for std::tie()
+
 #include "loudspeakerrenderer.h"
-#include "apf/combine_channels.h"
+#include "geometry.h"  // for vec3, quat
+#include "triangulation.h"  // for triangulate(), find_triangle()
+#include "ssr_global.h"  // for SSR_VERBOSE()
 
 namespace ssr
 {
@@ -59,7 +66,6 @@ class VbapRenderer : public LoudspeakerRenderer<VbapRenderer>
 
     class Source;
     class Output;
-    class RenderFunction;
 
     explicit VbapRenderer(const apf::parameter_map& params)
       : _base(params)
@@ -68,44 +74,67 @@ class VbapRenderer : public LoudspeakerRenderer<VbapRenderer>
           params.get("vbap_overhang_angle", apf::math::deg2rad(30.0)))
       , _overhang_func(2 * _overhang_angle)
       , _reference_position_offset(this->state.reference_position_offset.get())
-    {}
+      , _three_d(false)
+      , _lookup_resolution(apf::math::deg2rad(
+            params.get("vbap_lookup_resolution", 1.0f)))
+      , _lookup_azimuths(0)
+      , _lookup_elevations(0)
+    {
+      if (_lookup_resolution <= 0)
+      {
+        throw std::logic_error("vbap_lookup_resolution must be positive!");
+      }
+    }
 
     void load_reproduction_setup();
 
     APF_PROCESS(VbapRenderer, _base)
     {
-      // WARNING: The reference offset is currently broken!
-      // To make it work, we have to fiddle a bit.
-      auto temp = Position(this->state.reference_position_offset);
-      temp.rotate(-90.0);
-      _reference_position_offset = temp;
-
-      // TODO: once the reference offset is implemented correctly, do only this:
-      //_reference_position_offset = this->state.reference_position_offset.get();
-
-      if (_reference_position_offset.changed())
+      if (_three_d)
       {
-        // TODO: check if reference is 'inside' the array?
+        // NB: The reference offset is ignored in 3D mode.
+        _reference_position_3d = vec3(this->state.reference_position.get());
+        _inverse_reference_rotation
+          = gml::conj(quat(this->state.reference_rotation.get()));
+      }
+      else
+      {
+        // WARNING: The reference offset is currently broken!
+        // To make it work, we have to fiddle a bit.
+        auto temp = Position(this->state.reference_position_offset);
+        temp.rotate(-90.0);
+        _reference_position_offset = temp;
 
-        _update_angles();
+        // TODO: once the reference offset is implemented correctly,
+        // do only this:
+        //_reference_position_offset = this->state.reference_position_offset.get();
 
-        // The (circular) order will always be the same in a convex array.
-        // However, angles may be wrapped around 0 and 2*pi.
-        // Only in this case the list has to be re-sorted.
-        if (_sorted_loudspeakers.back() < _sorted_loudspeakers.front())
+        if (_reference_position_offset.changed())
         {
-          _sort_loudspeakers();
+          // TODO: check if reference is 'inside' the array?
+
+          _update_angles();
+
+          // The (circular) order will always be the same in a convex array.
+          // However, angles may be wrapped around 0 and 2*pi.
+          // Only in this case the list has to be re-sorted.
+          if (_sorted_loudspeakers.back() < _sorted_loudspeakers.front())
+          {
+            _sort_loudspeakers();
+          }
+
+          _update_valid_sections();
         }
 
-        _update_valid_sections();
+        _absolute_reference_position
+          = Position(_reference_position_offset).rotate(
+              Orientation(this->state.reference_rotation))
+          + Position(this->state.reference_position);
       }
 
-      _absolute_reference_position
-        = Position(_reference_position_offset).rotate(
-            Orientation(this->state.reference_rotation))
-        + Position(this->state.reference_position);
-
       _process_list(_source_list);
+
+      _scatter_contributions();
     }
 
   private:
@@ -137,9 +166,30 @@ class VbapRenderer : public LoudspeakerRenderer<VbapRenderer>
       float weight = 0.0;
     };
 
+    /// Non-zero contribution of one source to one output.
+    /// The contributions of each output form a singly linked list.
+    struct Contribution
+    {
+      const Source* source = nullptr;
+      float old_weight = 0.0;
+      float new_weight = 0.0;
+      const Contribution* next = nullptr;
+    };
+
+    /// Pre-calculated panning for one (azimuth, elevation) grid point.
+    struct LookupEntry
+    {
+      size_t triangle = 0;
+      std::array<float, 3> gains{};  // normalized
+    };
+
     void _update_angles();
     void _sort_loudspeakers();
     void _update_valid_sections();
+    void _scatter_contributions();
+
+    void _build_lookup_table();
+    const LookupEntry& _lookup(const vec3& direction) const;
 
     float _max_angle, _overhang_angle;
 
@@ -149,6 +199,20 @@ class VbapRenderer : public LoudspeakerRenderer<VbapRenderer>
 
     apf::BlockParameter<Position> _reference_position_offset;
     Position _absolute_reference_position;
+
+    /// List heads of contributions, indexed by Output::index
+    std::vector<const Contribution*> _contributions;
+
+    // 3D mode, enabled if any loudspeaker has a non-zero height
+
+    bool _three_d;
+    std::vector<const Output*> _triangle_loudspeakers;
+    std::vector<LoudspeakerTriangle> _triangles;
+    float _lookup_resolution;  // radians
+    size_t _lookup_azimuths, _lookup_elevations;
+    std::vector<LookupEntry> _lookup_table;  // azimuth-major
+    vec3 _reference_position_3d;
+    quat _inverse_reference_rotation;
 };
 
 class VbapRenderer::Source : public _base::Source
@@ -160,34 +224,17 @@ class VbapRenderer::Source : public _base::Source
 
     APF_PROCESS(Source, _base::Source)
     {
-      // NOTE: reference_rotation_offset doesn't affect rendering
-
-      float incidence_angle = apf::math::wrap_two_pi(apf::math::deg2rad(
-            ((Position(this->position)
-              - this->parent._absolute_reference_position).orientation()
-             - Orientation(this->parent.state.reference_rotation)).azimuth));
+      auto weights = this->parent._three_d
+        ? _calculate_loudspeaker_weights_3d()
+        : _calculate_loudspeaker_weights_2d();
 
-      auto l_begin = this->parent._sorted_loudspeakers.begin();
-      auto l_end = this->parent._sorted_loudspeakers.end();
-
-      auto second = apf::make_circular_iterator(l_begin, l_end
-          , std::upper_bound(l_begin, l_end, incidence_angle));
-
-      auto first = second;
-
-      --first;
-
-      auto weights = _calculate_loudspeaker_weights(incidence_angle
-          , *first, *second);
-
-      // Apply source volume, mute, ...
-      weights.first.weight *= this->weighting_factor;
-      weights.second.weight *= this->weighting_factor;
-
-      this->loudspeaker_weights = weights;
-
-      assert(this->loudspeaker_weights.first.exactly_one_assignment());
-      assert(this->loudspeaker_weights.second.exactly_one_assignment());
+      for (size_t i = 0; i < weights.size(); ++i)
+      {
+        // Apply source volume, mute, ...
+        weights[i].weight *= this->weighting_factor;
+        this->loudspeaker_weights[i] = weights[i];
+        assert(this->loudspeaker_weights[i].exactly_one_assignment());
+      }
     }
 
     bool get_output_levels(sample_type* first, sample_type* last) const
@@ -200,17 +247,14 @@ class VbapRenderer::Source : public _base::Source
       {
         // TODO: handle subwoofers!
 
-        if (this->loudspeaker_weights.first.get().ls_ptr == &out)
-        {
-          *current = this->loudspeaker_weights.first.get().weight;
-        }
-        else if (this->loudspeaker_weights.second.get().ls_ptr == &out)
+        *current = 0;
+        for (const auto& weight: this->loudspeaker_weights)
         {
-          *current = this->loudspeaker_weights.second.get().weight;
-        }
-        else
-        {
-          *current = 0;
+          if (weight.get().ls_ptr == &out)
+          {
+            *current = weight.get().weight;
+            break;
+          }
         }
 
         ++current;
@@ -221,38 +265,26 @@ class VbapRenderer::Source : public _base::Source
       return true;
     }
 
-  private:
-    std::pair<LoudspeakerWeight, LoudspeakerWeight>
-    _calculate_loudspeaker_weights(float angle
-          , const LoudspeakerEntry& first, const LoudspeakerEntry& second);
+    /// Prepend the (old and new) non-zero weights of this source to the
+    /// contribution lists of the affected outputs.
+    /// This is not thread-safe, it must be called for one source at a time.
+    void scatter_contributions(std::vector<const Contribution*>& heads);
 
-  public:
-    std::pair<apf::BlockParameter<LoudspeakerWeight>
-            , apf::BlockParameter<LoudspeakerWeight>> loudspeaker_weights;
-};
-
-class VbapRenderer::RenderFunction
-{
-  public:
-    RenderFunction(const Output& out) : _out(out) {}
+  private:
+    using weights_t = std::array<LoudspeakerWeight, 3>;
 
-    apf::CombineChannelsResult::type select(const Source& in);
+    weights_t _calculate_loudspeaker_weights_2d() const;
+    weights_t _calculate_loudspeaker_weights_3d() const;
 
-    sample_type operator()(sample_type in)
-    {
-      return in * _weight;
-    }
+    weights_t _calculate_loudspeaker_weights(float angle
+          , const LoudspeakerEntry& first, const LoudspeakerEntry& second)
+      const;
 
-    sample_type operator()(sample_type in, sample_type index)
-    {
-      return in * _interpolator(index);
-    }
+    std::array<Contribution, 6> _contributions;
 
-  private:
-    sample_type _weight;
-    apf::math::linear_interpolator<sample_type> _interpolator;
-
-    const Output& _out;
+  public:
+    /// Up to three loudspeakers (only two in 2D mode)
+    std::array<apf::BlockParameter<LoudspeakerWeight>, 3> loudspeaker_weights;
 };
 
 class VbapRenderer::Output : public _base::Output
@@ -260,7 +292,6 @@ class VbapRenderer::Output : public _base::Output
   public:
     Output(const Params& p)
       : _base::Output(p)
-      , _combiner(this->parent._source_list, this->buffer)
     {
       // TODO: handle loudspeaker delays?
       // TODO: optional delay line?
@@ -268,12 +299,39 @@ class VbapRenderer::Output : public _base::Output
 
     APF_PROCESS(Output, _base::Output)
     {
-      _combiner.process(RenderFunction(*this));
+      StageTimer::Scope timer(this->parent._stage_timer, StageTimer::combine);
+      std::fill(this->buffer.begin(), this->buffer.end(), sample_type());
+
+      for (auto contribution = this->parent._contributions[this->index]
+          ; contribution != nullptr
+          ; contribution = contribution->next)
+      {
+        const auto& source = *contribution->source;
+        auto out = this->buffer.begin();
+
+        if (contribution->old_weight == contribution->new_weight)
+        {
+          auto weight = contribution->new_weight;
+          for (auto in = source.begin(); in != source.end(); ++in, ++out)
+          {
+            *out += *in * weight;
+          }
+        }
+        else
+        {
+          _interpolator.set(contribution->old_weight
+              , contribution->new_weight, this->parent.block_size());
+          sample_type index = 0;
+          for (auto in = source.begin(); in != source.end(); ++in, ++out)
+          {
+            *out += *in * _interpolator(index++);
+          }
+        }
+      }
     }
 
   private:
-    apf::CombineChannelsInterpolation<rtlist_proxy<Source>, buffer_type>
-      _combiner;
+    apf::math::linear_interpolator<sample_type> _interpolator;
 };
 
 void
@@ -297,6 +355,10 @@ VbapRenderer::load_reproduction_setup()
     else  // loudspeaker type == normal
     {
       _sorted_loudspeakers.emplace_back(0, false, &out);
+      if (out.height != 0)
+      {
+        _three_d = true;
+      }
     }
   }
 
@@ -305,58 +367,159 @@ VbapRenderer::load_reproduction_setup()
     throw std::logic_error("No loudspeakers found!");
   }
 
-  _update_angles();
-  _sort_loudspeakers();
-  _update_valid_sections();
+  _contributions.resize(this->get_output_list().size());
+
+  if (_three_d)
+  {
+    auto directions = std::vector<vec3>();
+    for (const auto& entry: _sorted_loudspeakers)
+    {
+      const auto& ls = *entry.ls_ptr;
+      auto direction = vec3{ls.position.x, ls.position.y, ls.height};
+      auto length = gml::length(direction);
+      if (length < 0.0001f)
+      {
+        throw std::logic_error("VBAP: Loudspeaker at the origin!");
+      }
+      directions.push_back(direction / length);
+      _triangle_loudspeakers.push_back(&ls);
+    }
+    _triangles = triangulate(directions);
+    _build_lookup_table();
+
+    SSR_VERBOSE("VBAP: 3D mode, " << _triangles.size()
+        << " loudspeaker triangles, lookup table with " << _lookup_table.size()
+        << " directions.");
+  }
+  else
+  {
+    _update_angles();
+    _sort_loudspeakers();
+    _update_valid_sections();
+  }
 }
 
-apf::CombineChannelsResult::type
-VbapRenderer::RenderFunction::select(const Source& in)
+/// Pre-calculate triangle and gains for a grid of directions.
+void
+VbapRenderer::_build_lookup_table()
 {
-  const auto& ls = in.loudspeaker_weights;
+  using apf::math::pi;
+
+  _lookup_azimuths = std::max(size_t(1)
+      , size_t(std::round(2 * pi<float>() / _lookup_resolution)));
+  _lookup_elevations = size_t(std::round(pi<float>() / _lookup_resolution)) + 1;
 
-  assert(ls.first.get().ls_ptr != ls.second.get().ls_ptr
-      || ls.first.get().ls_ptr == nullptr);
+  _lookup_table.clear();
+  _lookup_table.reserve(_lookup_azimuths * _lookup_elevations);
 
-  auto get_weight = [this] (const LoudspeakerWeight& first
-      , const LoudspeakerWeight& second)
+  for (size_t a = 0; a < _lookup_azimuths; ++a)
   {
-    float weight = 0;
-    if (first.ls_ptr == &_out) { weight = first.weight; }
-    else if (second.ls_ptr == &_out) { weight = second.weight; }
-    return weight;
-  };
+    float azimuth = a * 2 * pi<float>() / _lookup_azimuths;
+    for (size_t e = 0; e < _lookup_elevations; ++e)
+    {
+      float elevation = std::min(-pi<float>() / 2 + e * _lookup_resolution
+          , pi<float>() / 2);
+      auto direction = vec3{std::cos(elevation) * std::cos(azimuth)
+        , std::cos(elevation) * std::sin(azimuth), std::sin(elevation)};
+
+      LookupEntry entry;
+      std::tie(entry.triangle, entry.gains)
+        = find_triangle(_triangles, direction);
+      _lookup_table.push_back(entry);
+    }
+  }
+}
 
-  auto old_weight = get_weight(ls.first.old(), ls.second.old());
-  auto new_weight = get_weight(ls.first, ls.second);
+/// Get the lookup table entry closest to @p direction (needn't be normalized).
+const VbapRenderer::LookupEntry&
+VbapRenderer::_lookup(const vec3& direction) const
+{
+  float azimuth = apf::math::wrap_two_pi(
+      std::atan2(direction[1], direction[0]));
+  float elevation = std::atan2(direction[2]
+      , std::hypot(direction[0], direction[1]));
 
-  using namespace apf::CombineChannelsResult;
+  auto a = size_t(azimuth / (2 * apf::math::pi<float>()) * _lookup_azimuths
+      + 0.5f) % _lookup_azimuths;
+  auto e = std::min(size_t((elevation + apf::math::pi<float>() / 2)
+        / _lookup_resolution + 0.5f), _lookup_elevations - 1);
 
-  if (old_weight == 0 && new_weight == 0)
+  return _lookup_table[a * _lookup_elevations + e];
+}
+
+void
+VbapRenderer::_scatter_contributions()
+{
+  // Each source contributes to at most six outputs (three before and three
+  // after a change), therefore the contributions are collected per output
+  // instead of letting each output look at all sources.
+  std::fill(_contributions.begin(), _contributions.end(), nullptr);
+  for (auto& source: apf::cast_proxy<Source, rtlist_t>(_source_list))
   {
-    return nothing;
+    source.scatter_contributions(_contributions);
   }
-  else if (old_weight == new_weight)
+}
+
+void
+VbapRenderer::Source::scatter_contributions(
+    std::vector<const Contribution*>& heads)
+{
+  const auto& ls = this->loudspeaker_weights;
+
+  auto get_weight = [&ls] (const Output* out, bool old)
   {
-    _weight = new_weight;
-    return constant;
-  }
-  else
+    for (const auto& weight: ls)
+    {
+      const auto& w = old ? weight.old() : weight.get();
+      if (w.ls_ptr == out) { return w.weight; }
+    }
+    return 0.0f;
+  };
+
+  const std::array<const Output*, 6> targets{{
+    ls[0].old().ls_ptr, ls[1].old().ls_ptr, ls[2].old().ls_ptr
+      , ls[0].get().ls_ptr, ls[1].get().ls_ptr, ls[2].get().ls_ptr}};
+
+  auto contribution = _contributions.begin();
+
+  for (auto target = targets.begin(); target != targets.end(); ++target)
   {
-    _interpolator.set(old_weight, new_weight, in.parent.block_size());
-    return change;
+    if (*target == nullptr
+        || std::find(targets.begin(), target, *target) != target)
+    {
+      continue;
+    }
+
+    auto old_weight = get_weight(*target, true);
+    auto new_weight = get_weight(*target, false);
+
+    if (old_weight == 0 && new_weight == 0)
+    {
+      continue;
+    }
+
+    auto& head = heads[(*target)->index];
+    contribution->source = this;
+    contribution->old_weight = old_weight;
+    contribution->new_weight = new_weight;
+    contribution->next = head;
+    head = &*contribution;
+    ++contribution;
   }
 }
 
 void
 VbapRenderer::_update_angles()
 {
+  // NB: The angles are updated in LoudspeakerRenderer whenever the reference
+  // (including _reference_position_offset) changes.
+  const auto& angles = this->loudspeaker_geometry().offset_angles;
+
   for (auto& ls: _sorted_loudspeakers)
   {
     // NOTE: reference_rotation_offset doesn't affect rendering
 
-    ls.angle = apf::math::wrap_two_pi(apf::math::deg2rad((ls.ls_ptr->position
-        - _reference_position_offset).orientation().azimuth));
+    ls.angle = angles[ls.ls_ptr->index];
   }
 }
 
@@ -388,14 +551,76 @@ VbapRenderer::_update_valid_sections()
   }
 }
 
-std::pair<VbapRenderer::LoudspeakerWeight, VbapRenderer::LoudspeakerWeight>
+VbapRenderer::Source::weights_t
+VbapRenderer::Source::_calculate_loudspeaker_weights_2d() const
+{
+  // NOTE: reference_rotation_offset doesn't affect rendering
+
+  float incidence_angle = apf::math::wrap_two_pi(apf::math::deg2rad(
+        ((Position(this->position)
+          - this->parent._absolute_reference_position).orientation()
+         - Orientation(this->parent.state.reference_rotation)).azimuth));
+
+  auto l_begin = this->parent._sorted_loudspeakers.begin();
+  auto l_end = this->parent._sorted_loudspeakers.end();
+
+  auto second = apf::make_circular_iterator(l_begin, l_end
+      , std::upper_bound(l_begin, l_end, incidence_angle));
+
+  auto first = second;
+
+  --first;
+
+  return _calculate_loudspeaker_weights(incidence_angle, *first, *second);
+}
+
+VbapRenderer::Source::weights_t
+VbapRenderer::Source::_calculate_loudspeaker_weights_3d() const
+{
+  const auto& parent = this->parent;
+
+  auto direction = vec3(gml::transform(parent._inverse_reference_rotation
+        , vec3(this->position.get()) - parent._reference_position_3d));
+
+  // The loudspeaker directions are given in the (legacy) coordinate system
+  // of the reproduction setup, which is rotated by 90 degrees.
+  direction = vec3{direction[1], -direction[0], direction[2]};
+
+  const auto& entry = parent._lookup(direction);
+  const auto& triangle = parent._triangles[entry.triangle];
+
+  // The lookup table only has a limited resolution, therefore the gains are
+  // re-calculated for the exact direction (but within the same triangle).
+  auto gains = triangle.gains(direction);
+  float norm = std::sqrt(
+      gains[0] * gains[0] + gains[1] * gains[1] + gains[2] * gains[2]);
+
+  if (norm < 0.000001f
+      || *std::min_element(gains.begin(), gains.end()) < -0.000001f * norm)
+  {
+    // Direction is outside of the triangle (or source is at the reference)
+    gains = entry.gains;
+    norm = 1.0f;
+  }
+
+  weights_t weights;
+  for (size_t i = 0; i < 3; ++i)
+  {
+    weights[i].ls_ptr = parent._triangle_loudspeakers[triangle.loudspeakers[i]];
+    weights[i].weight = std::max(gains[i], 0.0f) / norm;
+  }
+  return weights;
+}
+
+VbapRenderer::Source::weights_t
 VbapRenderer::Source::_calculate_loudspeaker_weights(float source_angle
-    , const LoudspeakerEntry& first, const LoudspeakerEntry& second)
+    , const LoudspeakerEntry& first, const LoudspeakerEntry& second) const
 {
   using namespace apf::math;
 
   // Constructed with defaults: nullptr/0.0
-  std::pair<LoudspeakerWeight, LoudspeakerWeight> weights;
+  // NB: In 2D mode, only the first two weights are used.
+  weights_t weights;
 
   if (first.valid_section)
   {
@@ -410,11 +635,11 @@ VbapRenderer::Source::_calculate_loudspeaker_weights(float source_angle
     float num2 = std::sin(phi) * std::cos(phi_0);
     float den  = 2 * std::cos(phi_0) * std::sin(phi_0);
 
-    weights.second.weight = (num1 + num2) / den;
-    weights.first.weight = (num1 - num2) / den;
+    weights[1].weight = (num1 + num2) / den;
+    weights[0].weight = (num1 - num2) / den;
 
-    weights.second.ls_ptr = second.ls_ptr;
-    weights.first.ls_ptr = first.ls_ptr;
+    weights[1].ls_ptr = second.ls_ptr;
+    weights[0].ls_ptr = first.ls_ptr;
   }
   else
   {
@@ -425,16 +650,16 @@ VbapRenderer::Source::_calculate_loudspeaker_weights(float source_angle
 
     if (overhang < max_overhang)
     {
-      weights.first.weight = overhang_func(overhang);
-      weights.first.ls_ptr = first.ls_ptr;
+      weights[0].weight = overhang_func(overhang);
+      weights[0].ls_ptr = first.ls_ptr;
     }
 
     overhang = wrap_two_pi(second.angle - source_angle);
 
     if (overhang < max_overhang)
     {
-      weights.second.weight = overhang_func(overhang);
-      weights.second.ls_ptr = second.ls_ptr;
+      weights[1].weight = overhang_func(overhang);
+      weights[1].ls_ptr = second.ls_ptr;
     }
   }
   return weights;
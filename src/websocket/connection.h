@@ -28,6 +28,7 @@
 #ifndef SSR_WEBSOCKET_CONNECTION_H
 #define SSR_WEBSOCKET_CONNECTION_H
 
+#include <cstdint>  // for uint64_t
 #include <optional>
 
 #define RAPIDJSON_HAS_STDSTRING 1
@@ -119,6 +120,7 @@ class Connection : public api::BundleEvents
                  , public api::MasterMetering
                  , public api::OutputActivity
                  , public api::CpuLoad
+                 , public api::DspTiming
 {
 public:
   explicit Connection(connection_hdl hdl, server_t& server
@@ -383,6 +385,39 @@ private:
     _update_object(_state, "cpu", load);
   }
 
+  // DspTiming
+
+  void stage_load(const std::string& stage, float* begin, float* end) override
+  {
+    json::Value loads{json::kArrayType};
+    loads.Reserve(std::distance(begin, end), _out_allocator);
+    for (float* ptr = begin; ptr != end; ++ptr)
+    {
+      loads.PushBack(*ptr, _out_allocator);
+    }
+    // All stages are collected in one object: {"sources": [...], ...}
+    auto iter = _state.FindMember("dsp-timing");
+    if (iter == _state.MemberEnd())
+    {
+      json::Value stages{json::kObjectType};
+      _add_member(_state, "dsp-timing", stages.Move());
+      iter = _state.FindMember("dsp-timing");
+    }
+    _update_object(iter->value, stage, loads.Move());
+  }
+
+  void parameter_updates(size_t received, size_t coalesced, size_t applied
+      , size_t pending) override
+  {
+    json::Value counters{json::kObjectType};
+    // NB: size_t isn't necessarily one of the types supported by RapidJSON
+    _add_member(counters, "received", uint64_t{received});
+    _add_member(counters, "coalesced", uint64_t{coalesced});
+    _add_member(counters, "applied", uint64_t{applied});
+    _add_member(counters, "pending", uint64_t{pending});
+    _update_object(_state, "parameter-updates", counters.Move());
+  }
+
   // End of inherited member functions
 
   /// For std::string, a copy is made
@@ -500,6 +535,7 @@ private:
   std::unique_ptr<api::Subscription> _master_metering_subscription;
   std::unique_ptr<api::Subscription> _output_activity_subscription;
   std::unique_ptr<api::Subscription> _cpu_load_subscription;
+  std::unique_ptr<api::Subscription> _dsp_timing_subscription;
 };
 
 
@@ -631,6 +667,17 @@ Connection::on_message(message_ptr msg)
             _cpu_load_subscription = subscribe->cpu_load(this);
           }
         }
+        else if (subscription == "dsp-timing")
+        {
+          if (_dsp_timing_subscription)
+          {
+            SSR_VERBOSE("Already subscribed: dsp-timing");
+          }
+          else
+          {
+            _dsp_timing_subscription = subscribe->dsp_timing(this);
+          }
+        }
         else
         {
           SSR_ERROR("Unknown subscription: " << subscription);
@@ -677,6 +724,10 @@ Connection::on_message(message_ptr msg)
         {
           _cpu_load_subscription.reset();
         }
+        else if (subscription == "dsp-timing")
+        {
+          _dsp_timing_subscription.reset();
+        }
         else
         {
           SSR_ERROR("Unknown subscription to cancel: " << subscription);
@@ -30,6 +30,9 @@
 #ifndef SSR_WFSRENDERER_H
 #define SSR_WFSRENDERER_H
 
+#include <algorithm>  // for std::copy(), std::fill()
+#include <atomic>
+
 #include "loudspeakerrenderer.h"
 #include "ssr_global.h"
 
@@ -58,12 +61,24 @@ class WfsRenderer : public SourceToOutput<WfsRenderer, LoudspeakerRenderer>
     class SourceChannel;
     class Output;
     class RenderFunction;
+    class OutputTile;
 
     WfsRenderer(const apf::parameter_map& params)
       : _base(params)
       , _fade(this->block_size())
       , _max_delay(this->params.get("delayline_size", 0))
       , _initial_delay(this->params.get("initial_delay", 0))
+      , _max_source_distance(this->params.get("max_source_distance", 100.0f))
+      , _grow_delaylines(this->params.get("grow_delaylines", true))
+      , _prefilter_placement(this->params.get("prefilter_placement", "input"))
+      , _prefilter_on_outputs(false)
+      , _tile_outputs(this->params.get("mixing_tile_outputs", 0))
+      , _tile_sources(this->params.get("mixing_tile_sources", 16))
+      , _output_tile_list(_fifo)
+      , _pipelined(this->params.get("pipelined", false))
+      , _pipeline_delay(_pipelined ? this->block_size() : 0)
+      , _fade_in_curve(this->block_size())
+      , _fade_out_curve(this->block_size())
     {
       // TODO: compute "ideal" initial delay?
       // TODO: check if given initial delay is sufficient?
@@ -97,42 +112,181 @@ class WfsRenderer : public SourceToOutput<WfsRenderer, LoudspeakerRenderer>
 
       _pre_filter.reset(new apf::conv::Filter(this->block_size()
             , ir.begin(), ir.end()));
+
+      if (_tile_sources == 0)
+      {
+        throw std::logic_error("mixing_tile_sources must be at least 1!");
+      }
+
+      if (_pipelined && _tile_outputs == 0)
+      {
+        // Only tiles can be processed together with the sources
+        _tile_outputs = 1;
+      }
+
+      // Same crossfade as in apf::CombineChannelsCrossfade, used in OutputTile
+      auto fade = apf::math::raised_cosine<sample_type>(
+          static_cast<sample_type>(2 * this->block_size()));
+      for (size_t i = 0; i < this->block_size(); ++i)
+      {
+        _fade_out_curve[i] = fade(static_cast<sample_type>(i));
+        _fade_in_curve[i] = 1 - _fade_out_curve[i];
+      }
     }
 
     APF_PROCESS(WfsRenderer, _base)
     {
+      _write_slot = 1 - _write_slot;
+      _read_slot = _pipelined ? 1 - _write_slot : _write_slot;
+
+      // In pipelined mode, the tiles are processed along with the sources
+      // (see _pipelined_items), except if there are no sources.
       this->_process_list(_source_list);
+
+      // If mixing is done in tiles, Output::process() doesn't combine sources
+      if (!_pipelined || _source_list.empty())
+      {
+        this->_process_list(_output_tile_list);
+      }
     }
 
+    void load_reproduction_setup();
+    void housekeeping();
+
   private:
+    size_t _delay_for_distance(float distance) const
+    {
+      return static_cast<size_t>(
+          std::ceil(distance * c_inverse * this->sample_rate())) + 1;
+    }
+
     apf::raised_cosine_fade<sample_type> _fade;
     std::unique_ptr<apf::conv::Filter> _pre_filter;
 
     size_t _max_delay, _initial_delay;
+    float _max_source_distance;  // from the reference point, in meters
+    bool _grow_delaylines;
+
+    const std::string _prefilter_placement;  // "input", "output" or "auto"
+    bool _prefilter_on_outputs;
+
+    size_t _tile_outputs;  // 0 means no tiling
+    size_t _tile_sources;
+    rtlist_t _output_tile_list;
+    /// One block per output (indexed by Output::index), mixed by the
+    /// OutputTiles.  The tiles run before the outputs get their buffers for
+    /// the current audio cycle, therefore they can't write to Output::buffer.
+    /// This also holds in pipelined mode, where the tiles are processed
+    /// concurrently with the sources: the outputs copy the mixed blocks
+    /// afterwards in the same cycle, so one block per output is enough.
+    std::vector<sample_type> _tile_buffers;
+
+    /// In pipelined mode, the tiles of the previous block are combined while
+    /// the sources of the current block are processed.  This needs one
+    /// additional block of latency (_pipeline_delay).  Each source stores its
+    /// State in two slots, one for each of those blocks.
+    const bool _pipelined;
+    const size_t _pipeline_delay;
+    size_t _write_slot = 0, _read_slot = 0;
+    std::vector<sample_type> _fade_in_curve, _fade_out_curve;
 };
 
 class WfsRenderer::Input : public _base::Input
 {
   public:
     friend class Source;  // give access to _delayline
+    friend class WfsRenderer;  // housekeeping() replaces _delayline
 
     Input(const Params& p)
       : _base::Input(p)
+      , required_delay(0)
+      , _delayline(new apf::NonCausalBlockDelayLine<sample_type>(
+            this->parent.block_size(), this->parent._max_delay
+            , this->parent._initial_delay))
+      , _delayline_size(this->parent._max_delay)
+    {
       // TODO: check if _pre_filter != 0!
-      , _convolver(*this->parent._pre_filter)
-      , _delayline(this->parent.block_size(), this->parent._max_delay
-          , this->parent._initial_delay)
-    {}
+      if (!this->parent._prefilter_on_outputs)
+      {
+        _convolver.reset(
+            new apf::conv::StaticConvolver(*this->parent._pre_filter));
+      }
+    }
 
     APF_PROCESS(Input, _base::Input)
     {
-      _convolver.add_block(this->buffer.begin());
-      _delayline.write_block(_convolver.convolve());
+      StageTimer::Scope timer(this->parent._stage_timer, StageTimer::inputs);
+      if (_convolver)
+      {
+        _convolver->add_block(this->buffer.begin());
+        _delayline->write_block(_convolver->convolve());
+      }
+      else
+      {
+        // The pre-filter is applied in Output::process()
+        _delayline->write_block(this->buffer.begin());
+      }
+    }
+
+    /// Remember a delay which didn't fit into the delay line.
+    /// This is called from the realtime thread(s).
+    void request_delay(size_t delay)
+    {
+      auto old = required_delay.load(std::memory_order_relaxed);
+      while (delay > old && !required_delay.compare_exchange_weak(old, delay
+            , std::memory_order_relaxed)) {}
+    }
+
+    std::atomic<size_t> required_delay;
+
+  private:
+    class ReplaceDelaylineCommand;
+
+    std::unique_ptr<apf::conv::StaticConvolver> _convolver;
+    std::unique_ptr<apf::NonCausalBlockDelayLine<sample_type>> _delayline;
+    size_t _delayline_size;  // only accessed by the non-realtime thread
+};
+
+/// Swap in a larger delay line, the old one is deleted in the non-RT thread.
+/// The history of the old delay line is copied, because other channels of
+/// the same source may still be reading from it.
+class WfsRenderer::Input::ReplaceDelaylineCommand
+                                          : public apf::CommandQueue::Command
+{
+  public:
+    ReplaceDelaylineCommand(Input& input
+        , std::unique_ptr<apf::NonCausalBlockDelayLine<sample_type>> delayline)
+      : _input(input)
+      , _delayline(std::move(delayline))
+    {}
+
+    virtual void execute()
+    {
+      // Copy block-wise, from the oldest to the newest block.  This is only
+      // done once per enlargement and the amount of data is bounded by the
+      // size of the old delay line.
+      const auto& old = *_input._delayline;
+      auto block_size = static_cast<int>(_input.parent.block_size());
+      auto initial_delay = static_cast<int>(_input.parent._initial_delay);
+      int blocks = 0;
+      while (old.delay_is_valid((blocks + 1) * block_size - initial_delay))
+      {
+        ++blocks;
+      }
+      for (int i = blocks; i >= 0; --i)
+      {
+        _delayline->write_block(
+            old.get_read_circulator(i * block_size - initial_delay));
+      }
+      _input._delayline.swap(_delayline);
     }
 
+    // Empty function, the old delay line is deleted in the destructor.
+    virtual void cleanup() {}
+
   private:
-    apf::conv::StaticConvolver _convolver;
-    apf::NonCausalBlockDelayLine<sample_type> _delayline;
+    Input& _input;
+    std::unique_ptr<apf::NonCausalBlockDelayLine<sample_type>> _delayline;
 };
 
 class WfsRenderer::SourceChannel : public apf::has_begin_and_end<
@@ -195,6 +349,7 @@ class WfsRenderer::Output : public _base::Output
 {
   public:
     friend class Source;  // to be able to see _sourcechannels
+    friend class WfsRenderer;  // load_reproduction_setup() sets _convolver etc.
 
     Output(const Params& p)
       : _base::Output(p)
@@ -203,15 +358,303 @@ class WfsRenderer::Output : public _base::Output
 
     APF_PROCESS(Output, _base::Output)
     {
-      _combiner.process(RenderFunction(*this));
+      if (_tile_buffer == nullptr)
+      {
+        StageTimer::Scope timer(this->parent._stage_timer
+            , StageTimer::combine);
+        _combiner.process(RenderFunction(*this));
+      }
+      else
+      {
+        // Sources have already been combined by an OutputTile
+        std::copy(_tile_buffer, _tile_buffer + this->parent.block_size()
+            , this->buffer.begin());
+      }
+
+      if (_convolver)
+      {
+        _convolver->add_block(this->buffer.begin());
+        auto result = _convolver->convolve();
+        std::copy(result, result + this->parent.block_size()
+            , this->buffer.begin());
+      }
     }
 
   private:
     apf::CombineChannelsCrossfade<apf::cast_proxy<SourceChannel
       , sourcechannels_t>, buffer_type
       , apf::raised_cosine_fade<sample_type>> _combiner;
+
+    // Only used if the pre-filter is applied after summation
+    std::unique_ptr<apf::conv::StaticConvolver> _convolver;
+
+    // Only used if mixing is done in tiles, see WfsRenderer::_tile_buffers
+    const sample_type* _tile_buffer = nullptr;
+};
+
+/** Cache-friendly combination of sources for a group of outputs.
+ * Instead of combining all sources for one output after the other, the
+ * sources are processed in tiles of @c mixing_tile_sources sources.
+ * Each tile is combined into all outputs of the OutputTile before moving on
+ * to the next tile of sources, therefore the delay line data of the current
+ * sources stays in the cache.
+ * This gives the same result as Output::process() with
+ * apf::CombineChannelsCrossfade.
+ * The result is written to WfsRenderer::_tile_buffers and copied to the
+ * output buffers in Output::process().
+ **/
+class WfsRenderer::OutputTile : public ProcessItem<OutputTile>
+{
+  public:
+    using channel_iterator = Output::sourcechannels_t::iterator;
+
+    /// @param buffers One block for each of the @p outputs
+    OutputTile(const WfsRenderer& parent, std::vector<Output*> outputs
+        , std::vector<sample_type*> buffers)
+      : _parent(parent)
+      , _outputs(std::move(outputs))
+      , _buffers(std::move(buffers))
+      , _positions(_outputs.size())
+    {
+      assert(_buffers.size() == _outputs.size());
+    }
+
+    APF_PROCESS(OutputTile, ProcessItem<OutputTile>)
+    {
+      StageTimer::Scope timer(_parent._stage_timer, StageTimer::combine);
+
+      for (size_t i = 0; i < _outputs.size(); ++i)
+      {
+        _positions[i] = _outputs[i]->sourcechannels.begin();
+        std::fill(_buffers[i], _buffers[i] + _parent.block_size()
+            , sample_type());
+      }
+
+      // NB: All outputs have the same number of SourceChannels
+      bool more_sources = true;
+      while (more_sources)
+      {
+        more_sources = false;
+        for (size_t i = 0; i < _outputs.size(); ++i)
+        {
+          auto& out = *_outputs[i];
+          auto& position = _positions[i];
+          auto render_function = RenderFunction(out);
+
+          for (size_t n = 0; n < _parent._tile_sources
+              && position != out.sourcechannels.end(); ++n, ++position)
+          {
+            _combine(render_function, **position, _buffers[i]);
+          }
+          if (position != out.sourcechannels.end()) more_sources = true;
+        }
+      }
+    }
+
+  private:
+    template<typename OutputIterator>
+    void _combine(RenderFunction& f, SourceChannel& channel, OutputIterator out)
+    {
+      using namespace apf::CombineChannelsResult;
+
+      auto block_size = _parent.block_size();
+      auto mode = f.select(channel);
+
+      if (mode == nothing) return;
+
+      if (mode == constant)
+      {
+        auto in = channel.begin();
+        for (size_t i = 0; i < block_size; ++i, ++in, ++out)
+        {
+          *out += f(*in);
+        }
+        return;
+      }
+
+      if (mode == fade_out || mode == change)
+      {
+        auto in = channel.begin();
+        auto o = out;
+        for (size_t i = 0; i < block_size; ++i, ++in, ++o)
+        {
+          *o += f(*in, apf::fade_out_tag()) * _parent._fade_out_curve[i];
+        }
+      }
+
+      if (mode == fade_in || mode == change)
+      {
+        f.update();  // read from the new delay
+        auto in = channel.begin();
+        for (size_t i = 0; i < block_size; ++i, ++in, ++out)
+        {
+          *out += f(*in) * _parent._fade_in_curve[i];
+        }
+      }
+    }
+
+    const WfsRenderer& _parent;
+    std::vector<Output*> _outputs;
+    std::vector<sample_type*> _buffers;
+    std::vector<channel_iterator> _positions;
 };
 
+/** Load loudspeakers and decide where the pre-filter is applied.
+ * The pre-filter is the same for all loudspeakers, therefore it can either be
+ * applied once per input (before the delay line) or once per output (after
+ * summation).  Whichever is cheaper depends on the number of sources and
+ * loudspeakers.
+ *
+ * NB: Both placements are only equivalent while the delays and weights of
+ * all sources are constant.  The rendering itself is time-variant (moving
+ * sources, crossfades after source or reference changes, volume changes,
+ * fade-in of new sources), and with the pre-filter on the outputs the
+ * filter's impulse response is applied to these transitions instead of
+ * fading between already filtered signals.  Therefore, "auto" only selects
+ * the output placement if there are fewer loudspeakers than the expected
+ * number of sources, and it says so with a warning.
+ * @throw std::logic_error if the placement is unknown
+ **/
+void
+WfsRenderer::load_reproduction_setup()
+{
+  _base::load_reproduction_setup();
+
+  using output_list_t = apf::cast_proxy<Output, rtlist_t>;
+  output_list_t outputs(const_cast<rtlist_t&>(this->get_output_list()));
+
+  if (_prefilter_placement == "input")
+  {
+    _prefilter_on_outputs = false;
+  }
+  else if (_prefilter_placement == "output")
+  {
+    _prefilter_on_outputs = true;
+  }
+  else if (_prefilter_placement == "auto")
+  {
+    _prefilter_on_outputs = outputs.size()
+      < this->params.get("expected_sources", size_t(32));
+    if (_prefilter_on_outputs)
+    {
+      SSR_WARNING("Applying the WFS pre-filter to the outputs. "
+          "This is not exactly equivalent while sources move or change "
+          "their volume. Use \"input\" placement to avoid this.");
+    }
+  }
+  else
+  {
+    throw std::logic_error("Unknown prefilter placement: \""
+        + _prefilter_placement + "\" (use input, output or auto)!");
+  }
+
+  SSR_VERBOSE("Applying WFS pre-filter to each "
+      << (_prefilter_on_outputs ? "output." : "input."));
+
+  if (_max_delay == 0)
+  {
+    // Loudspeakers are moved along with the reference, the source can be
+    // up to _max_source_distance away from it. Therefore, the distance
+    // between source and loudspeaker (and the delay computed in select(),
+    // also for plane waves and subwoofers) is limited by the triangle
+    // inequality.
+    float max_loudspeaker_distance = 0.0f;
+    for (const auto& out: outputs)
+    {
+      max_loudspeaker_distance
+        = std::max(max_loudspeaker_distance, out.position.length());
+    }
+    _max_delay = _delay_for_distance(
+        _max_source_distance + max_loudspeaker_distance);
+  }
+
+  // The previous block is read from the delay line in pipelined mode
+  _max_delay += _pipeline_delay;
+
+  SSR_VERBOSE("Using WFS delay lines with a maximum delay of " << _max_delay
+      << " samples" << (_grow_delaylines ? " (growing if needed)." : "."));
+
+  if (_prefilter_on_outputs)
+  {
+    // NB: No Input exists yet, so there is no need to lock
+    for (auto& out: outputs)
+    {
+      out._convolver.reset(new apf::conv::StaticConvolver(*_pre_filter));
+    }
+  }
+
+  if (_tile_outputs > 0)
+  {
+    // NB: This is never re-allocated, the tiles and outputs keep pointers
+    _tile_buffers.assign(outputs.size() * this->block_size(), sample_type());
+
+    auto tile = std::vector<Output*>();
+    auto buffers = std::vector<sample_type*>();
+    for (auto& out: outputs)
+    {
+      auto* buffer = _tile_buffers.data() + out.index * this->block_size();
+      out._tile_buffer = buffer;
+      tile.push_back(&out);
+      buffers.push_back(buffer);
+      if (tile.size() == _tile_outputs)
+      {
+        _output_tile_list.add(new OutputTile(*this, std::move(tile)
+              , std::move(buffers)));
+        tile.clear();
+        buffers.clear();
+      }
+    }
+    if (!tile.empty())
+    {
+      _output_tile_list.add(new OutputTile(*this, std::move(tile)
+            , std::move(buffers)));
+    }
+
+    SSR_VERBOSE("Mixing in tiles of " << _tile_outputs << " outputs and "
+        << _tile_sources << " sources.");
+  }
+
+  if (_pipelined)
+  {
+    for (auto& tile: _output_tile_list)
+    {
+      this->_pipelined_items.push_back(tile);
+    }
+    SSR_VERBOSE("Pipelined processing, the latency is increased by "
+        << this->block_size() << " samples.");
+  }
+}
+
+/** Enlarge delay lines of sources which moved too far away.
+ * The realtime thread records delays which didn't fit into the delay line
+ * (the affected source channels are muted in the meantime), the new delay
+ * line is allocated here and swapped in via the command queue, keeping the
+ * signal history for the other channels of the source.
+ **/
+void
+WfsRenderer::housekeeping()
+{
+  if (!_grow_delaylines) return;
+
+  this->_for_each_source([this] (Source& source)
+  {
+    auto& input = source.input;
+    auto required = input.required_delay.load(std::memory_order_relaxed);
+    if (required <= input._delayline_size) return;
+
+    // Leave some headroom to avoid re-allocating on each small movement
+    auto new_size = required + required / 4;
+
+    SSR_VERBOSE2("Enlarging delay line of source \"" << source.id << "\" to "
+        << new_size << " samples.");
+
+    _fifo.push(new Input::ReplaceDelaylineCommand(input
+          , std::make_unique<apf::NonCausalBlockDelayLine<sample_type>>(
+            this->block_size(), new_size, _initial_delay)));
+    input._delayline_size = new_size;
+  });
+}
+
 class WfsRenderer::Source : public _base::Source
 {
   private:
@@ -220,7 +663,7 @@ class WfsRenderer::Source : public _base::Source
   public:
     Source(const Params& p)
       : _base::Source(p, p.parent->get_output_list().size(), *this)
-      , delayline(p.input->_delayline)
+      , input(const_cast<Input&>(*p.input))
     {}
 
     APF_PROCESS(Source, _base::Source)
@@ -242,22 +685,49 @@ class WfsRenderer::Source : public _base::Source
       return true;
     }
 
-    const apf::NonCausalBlockDelayLine<sample_type>& delayline;
+    const apf::NonCausalBlockDelayLine<sample_type>& delayline() const
+    {
+      return *input._delayline;
+    }
+
+    Input& input;
+
+    /// Everything RenderFunction::select() needs to know about a source
+    struct State
+    {
+      Position position;
+      Orientation rotation;
+      SourceModel model = SourceModel::point;
+      bool focused = false;
+      sample_type weighting_factor = 0;
+    };
 
-    //private:
-    bool _focused;
+    /// State of the block which is currently combined
+    const State& state() const { return _states[this->parent._read_slot]; }
+
+  private:
+    State _states[2];
 };
 
 void WfsRenderer::Source::_process()
 {
-  if (this->model == "plane")
+  auto& state = _states[this->parent._write_slot];
+  state.position = Position(this->position);
+  state.rotation = Orientation(this->rotation);
+  state.model = this->model;
+  state.weighting_factor = this->weighting_factor;
+
+  if (this->model == SourceModel::plane)
   {
     // do nothing, focused-ness is irrelevant for plane waves
-    _focused = false;
+    state.focused = false;
   }
   else
   {
-    _focused = true;
+    state.focused = true;
+    const auto& geometry = this->parent.loudspeaker_geometry();
+    auto src_pos = Position(this->position);
+
     for (const auto& out: rtlist_proxy<Output>(this->parent.get_output_list()))
     {
       // subwoofers have to be ignored!
@@ -268,14 +738,9 @@ void WfsRenderer::Source::_process()
       // angle (modulo) between the line connecting source<->loudspeaker
       // and the loudspeaker orientation
 
-      // TODO: avoid getting reference 2 times (see select())
-      auto ls = DirectionalPoint(out);
-      auto ref = DirectionalPoint(Position(out.parent.state.reference_position)
-          , Orientation(out.parent.state.reference_rotation));
-      ls.transform(ref);
-
-      auto a = apf::math::wrap(angle(ls.position - Position(this->position)
-            , ls.orientation), 2 * apf::math::pi<sample_type>());
+      auto a = apf::math::wrap(angle(geometry.positions[out.index] - src_pos
+            , geometry.orientations[out.index])
+          , 2 * apf::math::pi<sample_type>());
 
       auto halfpi = apf::math::pi<sample_type>()/2;
 
@@ -283,7 +748,7 @@ void WfsRenderer::Source::_process()
       {
         // if at least one loudspeaker "turns its back" to the source, the
         // source is considered non-focused
-        _focused = false;
+        state.focused = false;
         break;
       }
     }
@@ -294,7 +759,7 @@ void WfsRenderer::Source::_process()
 
 void WfsRenderer::SourceChannel::update()
 {
-  _begin = this->source.delayline.get_read_circulator(this->delay);
+  _begin = this->source.delayline().get_read_circulator(this->delay);
   _end = _begin + source.parent.block_size();
 }
 
@@ -306,35 +771,28 @@ WfsRenderer::RenderFunction::select(SourceChannel& in)
   // define a restricted area around loudspeakers to avoid division by zero:
   const float safety_radius = 0.01f; // 1 cm
 
-  // TODO: move reference calculation to WfsRenderer::Process?
-  auto ref = DirectionalPoint(Position(_out.parent.state.reference_position)
-      , Orientation(_out.parent.state.reference_rotation));
-
-  // TODO: this is actually wrong!
-  // We use it to be compatible with the (also wrong) GUI implementation.
-  auto ref_off = ref;
-  ref_off.transform(DirectionalPoint(
-        Position(_out.parent.state.reference_position_offset)
-        , Orientation(_out.parent.state.reference_rotation_offset)
-          - Orientation(90)));
+  // Loudspeaker positions are transformed according to the reference once
+  // per block, see LoudspeakerRenderer::_update_loudspeaker_geometry()
+  const auto& geometry = _out.parent.loudspeaker_geometry();
+  const auto& ref_off = geometry.reference;
 
   sample_type weighting_factor = 1;
   float float_delay = 0;
 
-  auto ls = LegacyLoudspeaker(_out);
-  auto src_pos = Position(in.source.position);
-
-  // TODO: shortcut if in.source.weighting_factor == 0
+  auto ls = LegacyLoudspeaker(DirectionalPoint(geometry.positions[_out.index]
+        , geometry.orientations[_out.index]), _out.model, _out.weight);
+  // In pipelined mode, this is the state of the previous block
+  const auto& source = in.source.state();
+  auto src_pos = source.position;
 
-  // Transform loudspeaker position according to reference and offset
-  ls.transform(ref);
+  // TODO: shortcut if source.weighting_factor == 0
 
-  float reference_distance = (ls.position - ref_off.position).length();
+  float reference_distance = geometry.reference_distances[_out.index];
 
   float source_ls_distance = (ls.position - src_pos).length();
 
-  const std::string& model = in.source.model;
-  if (model == "point")
+  SourceModel model = source.model;
+  if (model == SourceModel::point)
   {
     if (ls.model == LegacyLoudspeaker::subwoofer)
     {
@@ -363,7 +821,7 @@ WfsRenderer::RenderFunction::select(SourceChannel& in)
       if (weighting_factor < 0.0f)
       {
         // negative weighting factor is only valid for focused sources
-        if (in.source._focused)
+        if (source.focused)
         {
           // loudspeaker selection:
 
@@ -413,7 +871,7 @@ WfsRenderer::RenderFunction::select(SourceChannel& in)
       }
       else if(weighting_factor > 0.0f) // positive weighting factor
       {
-        if (!in.source._focused)
+        if (!source.focused)
         {
           // non-focused point source
 
@@ -436,7 +894,7 @@ WfsRenderer::RenderFunction::select(SourceChannel& in)
       }
     }
   }
-  else if (model == "plane")
+  else if (model == SourceModel::plane)
   {
     if (ls.model == LegacyLoudspeaker::subwoofer)
     {
@@ -444,16 +902,14 @@ WfsRenderer::RenderFunction::select(SourceChannel& in)
       // the delay is calculated to be correct on the reference position
       // delay can be negative!
       float_delay
-        = DirectionalPoint(Position(in.source.position)
-            , Orientation(in.source.rotation))
+        = DirectionalPoint(src_pos, source.rotation)
         .plane_to_point_distance(ref_off.position) - reference_distance;
     }
     else
     {
       // weighting factor is determined by the cosine of the angle
       // difference between plane wave direction and loudspeaker direction
-      weighting_factor = cos(angle(
-            Orientation(in.source.rotation), ls.orientation));
+      weighting_factor = cos(angle(source.rotation, ls.orientation));
       // check if loudspeaker is active for this source
       if (weighting_factor < 0)
       {
@@ -462,8 +918,7 @@ WfsRenderer::RenderFunction::select(SourceChannel& in)
       }
       else
       {
-        float_delay = DirectionalPoint(Position(in.source.position)
-                                     , Orientation(in.source.rotation))
+        float_delay = DirectionalPoint(src_pos, source.rotation)
           .plane_to_point_distance(ls.position);
 
         if (float_delay < 0.0)
@@ -483,7 +938,7 @@ WfsRenderer::RenderFunction::select(SourceChannel& in)
   }
 
 #if defined(WEIGHTING_OLD)
-  if (model == "point")
+  if (model == SourceModel::point)
   {
     // compensate for inherent distance decay (approx. 1/sqrt(r))
     // no compensation closer to 0.5 m to the reference
@@ -500,7 +955,7 @@ WfsRenderer::RenderFunction::select(SourceChannel& in)
 #endif
 
   // apply the gain factor of the current source
-  weighting_factor *= in.source.weighting_factor;
+  weighting_factor *= source.weighting_factor;
 
   // apply tapering
   weighting_factor *= ls.weight;
@@ -516,9 +971,10 @@ WfsRenderer::RenderFunction::select(SourceChannel& in)
 
   // TODO: do proper rounding
   // TODO: enable interpolated reading from delay line.
-  int int_delay = static_cast<int>(float_delay + 0.5f);
+  int int_delay = static_cast<int>(float_delay + 0.5f)
+    + static_cast<int>(_out.parent._pipeline_delay);
 
-  if (in.source.delayline.delay_is_valid(int_delay))
+  if (in.source.delayline().delay_is_valid(int_delay))
   {
     in.delay = int_delay;
     in.weighting_factor = weighting_factor;
@@ -527,6 +983,12 @@ WfsRenderer::RenderFunction::select(SourceChannel& in)
   {
     // TODO: some sort of warning message?
 
+    if (int_delay > 0 && weighting_factor != 0)
+    {
+      // The delay line may be enlarged in housekeeping()
+      in.source.input.request_delay(static_cast<size_t>(int_delay));
+    }
+
     in.delay = 0;
     in.weighting_factor = 0;
   }
@@ -567,7 +1029,7 @@ WfsRenderer::RenderFunction::select(SourceChannel& in)
   }
   else
   {
-    in._begin = in.source.delayline.get_read_circulator(in.delay.old());
+    in._begin = in.source.delayline().get_read_circulator(in.delay.old());
     in._end = in._begin + _out.parent.block_size();
   }
 
@@ -0,0 +1,175 @@
+#include "catch/catch.hpp"
+
+#include <algorithm>  // for std::max_element()
+#include <cmath>  // for std::cos(), std::sqrt()
+
+#include "ambisonicstools.h"
+
+using ssr::vec3;
+using ssr::SphericalHarmonics;
+
+namespace {
+
+const double pi = apf::math::pi<double>();
+
+double panning_function(const std::vector<double>& weights, double angle)
+{
+    double result = weights[0];
+    for (size_t m = 1; m < weights.size(); ++m) {
+        result += 2 * weights[m] * std::cos(m * angle);
+    }
+    return result;
+}
+
+std::vector<double> decode(const ssr::AllRadDecoder& decoder
+    , const SphericalHarmonics& harmonics, const vec3& direction)
+{
+    auto values = std::vector<double>(harmonics.size());
+    harmonics(direction, values.begin());
+    auto result = std::vector<double>();
+    for (auto row = decoder.matrix.begin(); row != decoder.matrix.end()
+            ; row += values.size()) {
+        double gain = 0;
+        for (size_t i = 0; i < values.size(); ++i) {
+            gain += row[i] * values[i];
+        }
+        result.push_back(gain);
+    }
+    return result;
+}
+
+}  // unnamed namespace
+
+TEST_CASE("circular_modal_weights") {
+
+    SECTION("in-phase") {
+        for (int order: {1, 2, 5}) {
+            auto weights = ssr::circular_modal_weights(order, true);
+            REQUIRE(weights.size() == size_t(order + 1));
+            CHECK(panning_function(weights, 0) == Approx(1.0));
+            CHECK(panning_function(weights, pi) == Approx(0.0).margin(1e-12));
+            // cos^(2N)(x/2)
+            CHECK(panning_function(weights, 1.0)
+                == Approx(std::pow(std::cos(0.5), 2 * order)));
+        }
+    }
+
+    SECTION("basic") {
+        for (int order: {1, 2, 5}) {
+            auto weights = ssr::circular_modal_weights(order, false);
+            CHECK(panning_function(weights, 0) == Approx(1.0));
+            // zeros at the other loudspeakers of a regular 2N+1 setup
+            CHECK(panning_function(weights, 2 * pi / (2 * order + 1))
+                == Approx(0.0).margin(1e-12));
+        }
+    }
+}
+
+TEST_CASE("max_re_weights") {
+
+    auto weights = ssr::max_re_weights(1);
+    REQUIRE(weights.size() == 2);
+    CHECK(weights[0] == 1.0);
+    CHECK(weights[1] == Approx(0.577).epsilon(0.01));
+
+    weights = ssr::max_re_weights(4);
+    for (size_t n = 1; n < weights.size(); ++n) {
+        CHECK(weights[n] < weights[n - 1]);
+        CHECK(weights[n] > 0);
+    }
+}
+
+TEST_CASE("SphericalHarmonics") {
+
+    SECTION("size") {
+        CHECK(SphericalHarmonics(0).size() == 1);
+        CHECK(SphericalHarmonics(3).size() == 16);
+    }
+
+    SECTION("order 1 (ACN, N3D)") {
+        auto harmonics = SphericalHarmonics(1);
+        auto values = std::vector<double>(4);
+        harmonics(vec3{0, 2, 0}, values.begin());  // not normalized
+        CHECK(values[0] == Approx(1.0));
+        CHECK(values[1] == Approx(std::sqrt(3.0)));  // y
+        CHECK(values[2] == Approx(0.0).margin(1e-12));  // z
+        CHECK(values[3] == Approx(0.0).margin(1e-12));  // x
+
+        harmonics(vec3{0, 0, -1}, values.begin());
+        CHECK(values[2] == Approx(-std::sqrt(3.0)));
+    }
+
+    SECTION("orthonormal on the sphere") {
+        const int order = 3;
+        auto harmonics = SphericalHarmonics(order);
+        const size_t size = harmonics.size();
+        const size_t points = 5000;
+        const double golden_angle = pi * (3.0 - std::sqrt(5.0));
+
+        auto values = std::vector<double>(size);
+        auto gram = std::vector<double>(size * size);
+        for (size_t j = 0; j < points; ++j) {
+            double z = 1.0 - (2.0 * j + 1.0) / points;
+            double r = std::sqrt(1.0 - z * z);
+            harmonics(vec3{float(r * std::cos(j * golden_angle))
+                , float(r * std::sin(j * golden_angle)), float(z)}
+                , values.begin());
+            for (size_t a = 0; a < size; ++a) {
+                for (size_t b = 0; b < size; ++b) {
+                    gram[a * size + b] += values[a] * values[b] / points;
+                }
+            }
+        }
+        for (size_t a = 0; a < size; ++a) {
+            for (size_t b = 0; b < size; ++b) {
+                CHECK(gram[a * size + b]
+                    == Approx(a == b ? 1.0 : 0.0).margin(0.01));
+            }
+        }
+    }
+}
+
+TEST_CASE("allrad_decoder") {
+
+    SECTION("octahedron") {
+        auto directions = std::vector<vec3>{
+            {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}
+            , {0, 0, -1}};
+        auto harmonics = SphericalHarmonics(1);
+        auto decoder = ssr::allrad_decoder(directions, harmonics
+            , ssr::max_re_weights(1));
+
+        CHECK(decoder.triangles == 8);
+        CHECK(decoder.virtual_loudspeakers >= 2000);
+        REQUIRE(decoder.matrix.size() == directions.size() * 4);
+
+        // All loudspeakers get the same share of the omnidirectional part
+        for (size_t ls = 1; ls < directions.size(); ++ls) {
+            CHECK(decoder.matrix[ls * 4]
+                == Approx(decoder.matrix[0]).epsilon(0.01));
+        }
+
+        // A source in a loudspeaker direction is loudest there
+        for (size_t ls = 0; ls < directions.size(); ++ls) {
+            auto gains = decode(decoder, harmonics, directions[ls]);
+            auto loudest = std::max_element(gains.begin(), gains.end());
+            CHECK(size_t(loudest - gains.begin()) == ls);
+        }
+    }
+
+    SECTION("imaginary loudspeakers are discarded") {
+        // Horizontal ring, top and bottom are added internally
+        auto directions = std::vector<vec3>{
+            {1, 0, 0}, {0, 1, 0}, {-1, 0, 0}, {0, -1, 0}};
+        auto harmonics = SphericalHarmonics(1);
+        auto decoder = ssr::allrad_decoder(directions, harmonics
+            , std::vector<double>(2, 1.0));
+        CHECK(decoder.triangles == 8);
+        CHECK(decoder.matrix.size() == directions.size() * 4);
+
+        auto gains = decode(decoder, harmonics, vec3{0, 1, 0});
+        CHECK(gains[1] > gains[0]);
+        CHECK(gains[0] == Approx(gains[2]).margin(1e-3));
+        CHECK(gains[1] > gains[3]);
+    }
+}
@@ -0,0 +1,174 @@
+/******************************************************************************
+ * Copyright © 2012-2014 Institut für Nachrichtentechnik, Universität Rostock *
+ * Copyright © 2006-2012 Quality & Usability Lab,                             *
+ *                       Telekom Innovation Laboratories, TU Berlin           *
+ *                                                                            *
+ * This file is part of the SoundScape Renderer (SSR).                        *
+ *                                                                            *
+ * The SSR is free software:  you can redistribute it and/or modify it  under *
+ * the terms of the  GNU  General  Public  License  as published by the  Free *
+ * Software Foundation, either version 3 of the License,  or (at your option) *
+ * any later version.                                                         *
+ *                                                                            *
+ * The SSR is distributed in the hope that it will be useful, but WITHOUT ANY *
+ * WARRANTY;  without even the implied warranty of MERCHANTABILITY or FITNESS *
+ * FOR A PARTICULAR PURPOSE.                                                  *
+ * See the GNU General Public License for more details.                       *
+ *                                                                            *
+ * You should  have received a copy  of the GNU General Public License  along *
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                            *
+ * The SSR is a tool  for  real-time  spatial audio reproduction  providing a *
+ * variety of rendering algorithms.                                           *
+ *                                                                            *
+ * http://spatialaudio.net/ssr                           ssr@spatialaudio.net *
+ ******************************************************************************/
+
+/// @file
+/// Benchmark for the WFS renderer with a synthetic loudspeaker setup.
+///
+/// Usage: benchmark_wfs [TILE_OUTPUTS [TILE_SOURCES [THREADS [SOURCES
+///                      [LOUDSPEAKERS [PIPELINED]]]]]]
+///
+/// TILE_OUTPUTS = 0 (the default) disables tiled mixing.
+/// PIPELINED = 1 enables pipelined processing (default: 0).
+///
+/// Untiled vs. tiled mixing of 64 sources on 512 loudspeakers:
+///
+///     make benchmark_wfs
+///     ./benchmark_wfs 0 16 1 64 512
+///     ./benchmark_wfs 32 16 1 64 512
+
+#include <chrono>
+#include <cmath>  // for std::cos(), std::sin()
+#include <cstdlib>  // for std::atoi()
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "apf/pointer_policy.h"
+#include "wfsrenderer.h"
+
+namespace
+{
+
+std::string write_setup(size_t loudspeakers)
+{
+  auto file_name = (std::filesystem::temp_directory_path()
+      / "ssr_benchmark_wfs_setup.asd").string();
+  std::ofstream setup(file_name);
+  setup << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+    "<asdf>\n"
+    "  <reproduction_setup>\n"
+    "    <circular_array number=\"" << loudspeakers << "\">\n"
+    "      <first>\n"
+    "        <position x=\"3\" y=\"0\"/>\n"
+    "        <orientation azimuth=\"-180\"/>\n"
+    "      </first>\n"
+    "    </circular_array>\n"
+    "  </reproduction_setup>\n"
+    "</asdf>\n";
+  return file_name;
+}
+
+}  // unnamed namespace
+
+int main(int argc, char* argv[])
+{
+  size_t tile_outputs = argc > 1 ? std::atoi(argv[1]) : 0;
+  size_t tile_sources = argc > 2 ? std::atoi(argv[2]) : 16;
+  size_t threads = argc > 3 ? std::atoi(argv[3]) : 1;
+  size_t sources = argc > 4 ? std::atoi(argv[4]) : 64;
+  size_t loudspeakers = argc > 5 ? std::atoi(argv[5]) : 512;
+  bool pipelined = argc > 6 ? std::atoi(argv[6]) != 0 : false;
+
+  const size_t sample_rate = 44100;
+  const size_t block_size = 256;
+  const size_t warmup_blocks = 20;
+  const size_t blocks = 500;
+
+  XMLParser::Init();
+
+  apf::parameter_map params;
+  params.set("sample_rate", sample_rate);
+  params.set("block_size", block_size);
+  params.set("threads", threads);
+  params.set("reproduction_setup", write_setup(loudspeakers));
+  params.set("prefilter_file", SSR_DATA_DIR
+      "/impulse_responses/wfs_prefilters/wfs_prefilter_120_1500_44100.wav");
+  params.set("initial_delay", 1000);
+  params.set("mixing_tile_outputs", tile_outputs);
+  params.set("mixing_tile_sources", tile_sources);
+  params.set("pipelined", pipelined);
+
+  ssr::WfsRenderer renderer(params);
+  renderer.load_reproduction_setup();
+
+  for (size_t i = 0; i < sources; ++i)
+  {
+    // Sources on a circle around the array
+    float angle = 2 * apf::math::pi<float>() * i / sources;
+    auto id = renderer.add_source("");
+    auto* source = renderer.get_source(id);
+    source->position = Position(5 * std::cos(angle), 5 * std::sin(angle));
+    source->active = true;
+  }
+
+  auto generator = std::mt19937();
+  auto distribution = std::uniform_real_distribution<float>(-0.5f, 0.5f);
+
+  auto input_data = std::vector<std::vector<float>>(sources
+      , std::vector<float>(block_size));
+  for (auto& channel: input_data)
+  {
+    for (auto& sample: channel) sample = distribution(generator);
+  }
+  auto output_data = std::vector<std::vector<float>>(loudspeakers
+      , std::vector<float>(block_size));
+
+  auto inputs = std::vector<float*>();
+  for (auto& channel: input_data) inputs.push_back(channel.data());
+  auto outputs = std::vector<float*>();
+  for (auto& channel: output_data) outputs.push_back(channel.data());
+
+  renderer.activate();
+
+  for (size_t i = 0; i < warmup_blocks; ++i)
+  {
+    renderer.audio_callback(block_size, inputs.data(), outputs.data());
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < blocks; ++i)
+  {
+    renderer.audio_callback(block_size, inputs.data(), outputs.data());
+  }
+  auto stop = std::chrono::steady_clock::now();
+
+  renderer.deactivate();
+
+  auto seconds = std::chrono::duration<double>(stop - start).count();
+  auto block_duration = static_cast<double>(block_size) / sample_rate;
+
+  std::cout << sources << " sources, " << loudspeakers << " loudspeakers, "
+    << threads << " thread(s), tiles: ";
+  if (tile_outputs == 0)
+  {
+    std::cout << "off";
+  }
+  else
+  {
+    std::cout << tile_outputs << " outputs x " << tile_sources << " sources";
+  }
+  if (pipelined)
+  {
+    std::cout << ", pipelined";
+  }
+  std::cout << "\n" << 1e6 * seconds / blocks << " us per block ("
+    << 100 * seconds / (blocks * block_duration) << " % of real time)"
+    << std::endl;
+
+  return EXIT_SUCCESS;
+}
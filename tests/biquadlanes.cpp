@@ -0,0 +1,130 @@
+#include "catch/catch.hpp"
+
+#include <random>
+#include <vector>
+
+#include "biquadlanes.h"
+
+using ssr::BiQuadLanes;
+
+namespace {
+
+struct Sos
+{
+    double b0, b1, b2, a1, a2;
+};
+
+/// Reference implementation: cascade of Direct Form II sections, one sample
+/// at a time.
+class Cascade
+{
+  public:
+    explicit Cascade(const std::vector<Sos>& sections)
+        : _sections(sections)
+        , _w1(sections.size())
+        , _w2(sections.size())
+    {}
+
+    double operator()(double x)
+    {
+        for (size_t s = 0; s < _sections.size(); ++s) {
+            const auto& c = _sections[s];
+            double w0 = x - c.a1 * _w1[s] - c.a2 * _w2[s];
+            x = c.b0 * w0 + c.b1 * _w1[s] + c.b2 * _w2[s];
+            _w2[s] = _w1[s];
+            _w1[s] = w0;
+        }
+        return x;
+    }
+
+  private:
+    std::vector<Sos> _sections;
+    std::vector<double> _w1, _w2;
+};
+
+// A few stable sections (poles inside the unit circle)
+const std::vector<Sos> sections = {
+    {0.5, 0.2, 0.1, -0.9, 0.2},
+    {1.0, -1.2, 0.5, -1.5, 0.7},
+    {0.3, 0.3, 0.0, 0.4, 0.0},
+};
+
+}  // unnamed namespace
+
+TEST_CASE("BiQuadLanes") {
+
+    const size_t block_size = 64;
+
+    SECTION("sections must be sorted") {
+        CHECK_THROWS_AS(BiQuadLanes<double>({1, 2}, block_size)
+            , std::logic_error);
+        CHECK_NOTHROW(BiQuadLanes<double>({2, 2, 1, 0}, block_size));
+    }
+
+    SECTION("lanes are equivalent to Direct Form II cascades") {
+        // Lanes with a different number of sections
+        auto lanes = BiQuadLanes<double>({3, 2, 1, 0}, block_size);
+        auto reference = std::vector<Cascade>();
+        for (size_t lane = 0; lane < lanes.lanes(); ++lane) {
+            auto first = sections.begin() + lane;
+            lanes.set(lane, first, sections.end());
+            reference.emplace_back(std::vector<Sos>(first, sections.end()));
+        }
+
+        // New coefficients are faded in during the first block, with zero
+        // input the state stays (nearly) zero.
+        auto input = std::vector<double>(block_size);
+        lanes.execute(input.begin(), input.end());
+
+        auto generator = std::mt19937();
+        auto distribution = std::uniform_real_distribution<double>(-1, 1);
+        auto output = std::vector<double>(block_size);
+
+        for (int block = 0; block < 10; ++block) {
+            for (auto& sample: input) {
+                sample = distribution(generator);
+            }
+            // Blocks don't have to be full
+            auto size = block_size - block;
+            lanes.execute(input.begin(), input.begin() + size);
+
+            for (size_t lane = 0; lane < lanes.lanes(); ++lane) {
+                auto end = lanes.copy_lane(lane, output.begin());
+                REQUIRE(size_t(end - output.begin()) == size);
+                for (size_t n = 0; n < size; ++n) {
+                    CHECK(output[n]
+                        == Approx(reference[lane](input[n])).margin(1e-12));
+                }
+            }
+        }
+    }
+
+    SECTION("new coefficients are interpolated") {
+        auto lanes = BiQuadLanes<double>({1}, block_size, 16);
+        auto gain = [](double g) { return Sos{g, 0, 0, 0, 0}; };
+        auto input = std::vector<double>(block_size, 1.0);
+        auto output = std::vector<double>(block_size);
+
+        auto c = std::vector<Sos>{gain(1.0)};
+        lanes.set(0, c.begin(), c.end());
+        lanes.execute(input.begin(), input.end());
+
+        c[0] = gain(5.0);
+        lanes.set(0, c.begin(), c.end());
+        lanes.execute(input.begin(), input.end());
+        lanes.copy_lane(0, output.begin());
+
+        // 4 ramps of 16 samples: 1, 2, 3, 4
+        CHECK(output[0] == Approx(1.0));
+        CHECK(output[15] == Approx(1.0));
+        CHECK(output[16] == Approx(2.0));
+        CHECK(output[48] == Approx(4.0));
+        CHECK(output[63] == Approx(4.0));
+
+        // After the ramp, the target is reached
+        lanes.execute(input.begin(), input.end());
+        lanes.copy_lane(0, output.begin());
+        CHECK(output[0] == Approx(5.0));
+        CHECK(output[63] == Approx(5.0));
+    }
+}
@@ -0,0 +1,109 @@
+#include "catch/catch.hpp"
+
+#include <thread>
+
+#include "coalescedparameter.h"
+
+using ssr::CoalescedParameter;
+using ssr::CoalescingStatistics;
+
+TEST_CASE("CoalescedParameter") {
+
+    std::atomic<unsigned> dirty{0};
+    CoalescingStatistics statistics;
+    CoalescedParameter<int> p(dirty, 4, statistics, 7);
+
+    SECTION("initial value") {
+        CHECK(p.get() == 7);
+        CHECK_FALSE(p.update());
+        CHECK(dirty == 0);
+        CHECK(statistics.get().updates == 0);
+    }
+
+    SECTION("value is only visible after update()") {
+        p = 1;
+        CHECK(dirty == 4);
+        CHECK(p.get() == 7);
+        CHECK(p.update());
+        CHECK(p.get() == 1);
+        CHECK_FALSE(p.update());
+        CHECK(p.get() == 1);
+    }
+
+    SECTION("dirty bit is shared") {
+        CoalescedParameter<int> other(dirty, 1, statistics);
+        p = 1;
+        other = 2;
+        CHECK(dirty == 5);
+    }
+
+    SECTION("only the latest value is kept") {
+        p = 1;
+        p = 2;
+        p = 3;
+        CHECK(p.update());
+        CHECK(p.get() == 3);
+        auto counters = statistics.get();
+        CHECK(counters.updates == 3);
+        CHECK(counters.coalesced == 2);
+        CHECK(counters.applied == 1);
+        CHECK(counters.pending() == 0);
+    }
+
+    SECTION("pending values") {
+        p = 1;
+        CHECK(statistics.get().pending() == 1);
+        p.update();
+        CHECK(statistics.get().pending() == 0);
+    }
+
+    SECTION("buffers are not overwritten after update()") {
+        // Cycle through all three buffers a few times
+        for (int i = 1; i < 10; ++i) {
+            p = i;
+            p = i * 100;
+            CHECK(p.update());
+            CHECK(p.get() == i * 100);
+        }
+    }
+
+    SECTION("set_from_rt_thread()") {
+        p.set_from_rt_thread(5);
+        CHECK(p.get() == 5);
+        CHECK_FALSE(p.update());
+
+        // A pending value has precedence
+        p = 6;
+        p.set_from_rt_thread(5);
+        CHECK(p.update());
+        CHECK(p.get() == 6);
+    }
+
+    SECTION("handoff between threads") {
+        constexpr int last = 100000;
+        std::thread writer([&p]() {
+            for (int i = 1; i <= last; ++i) {
+                p = i;
+            }
+        });
+
+        // Values must never go backwards and the last one must arrive
+        int previous = 0;
+        bool monotonic = true;
+        while (previous != last) {
+            if (p.update()) {
+                if (p.get() <= previous) {
+                    monotonic = false;
+                }
+                previous = p.get();
+            }
+        }
+        writer.join();
+        CHECK(monotonic);
+
+        auto counters = statistics.get();
+        CHECK(counters.updates == last);
+        CHECK(counters.coalesced + counters.applied == last);
+        CHECK(counters.pending() == 0);
+    }
+}
@@ -0,0 +1,81 @@
+#include "catch/catch.hpp"
+
+#include <cmath>  // for std::pow()
+#include <limits>
+
+#include "dcacoefficients.h"
+
+using ssr::DcaCoefficients;
+using ssr::DcaCoefficientTable;
+
+namespace {
+
+void check_equal(const DcaCoefficients<double>& a
+    , const DcaCoefficients<double>& b)
+{
+    REQUIRE(a.size() == b.size());
+    for (size_t i = 0; i < a.size(); ++i) {
+        CHECK(a[i].b0 == Approx(b[i].b0));
+        CHECK(a[i].b1 == Approx(b[i].b1));
+        CHECK(a[i].b2 == Approx(b[i].b2));
+        CHECK(a[i].a1 == Approx(b[i].a1));
+        CHECK(a[i].a2 == Approx(b[i].a2));
+    }
+}
+
+}  // unnamed namespace
+
+TEST_CASE("DcaCoefficientTable") {
+
+    const size_t order = 5, sample_rate = 44100, steps = 24;
+    const float radius = 1.5f, c = 343.0f;
+
+    auto table = DcaCoefficientTable<double>(order, sample_rate, radius, c
+        , 10, steps);
+    auto result = DcaCoefficients<double>(order, sample_rate, radius, c);
+    auto expected = DcaCoefficients<double>(order, sample_rate, radius, c);
+
+    SECTION("grid points") {
+        for (size_t i: {0, 1, 23, 24, 100, 239, 240}) {
+            float distance = radius * std::pow(2.0f, float(i) / steps);
+            REQUIRE(table.lookup(distance, result));
+            expected.reset(distance, DcaCoefficients<double>::point_source);
+            check_equal(result, expected);
+        }
+    }
+
+    SECTION("between grid points") {
+        float distance = radius * std::pow(2.0f, 2.5f / steps);
+        REQUIRE(table.lookup(distance, result));
+
+        auto first = expected, second = expected;
+        first.reset(radius * std::pow(2.0f, 2.0f / steps)
+            , DcaCoefficients<double>::point_source);
+        second.reset(radius * std::pow(2.0f, 3.0f / steps)
+            , DcaCoefficients<double>::point_source);
+        for (size_t i = 0; i < expected.size(); ++i) {
+            expected[i] = first[i] + 0.5 * (second[i] - first[i]);
+        }
+        check_equal(result, expected);
+
+        // Close to the exact coefficients
+        expected.reset(distance, DcaCoefficients<double>::point_source);
+        for (size_t i = 0; i < expected.size(); ++i) {
+            CHECK(result[i].a1 == Approx(expected[i].a1).epsilon(1e-3));
+            CHECK(result[i].a2 == Approx(expected[i].a2).epsilon(1e-3));
+        }
+    }
+
+    SECTION("outside of the table") {
+        expected.reset(2 * radius, DcaCoefficients<double>::point_source);
+        result.reset(2 * radius, DcaCoefficients<double>::point_source);
+        CHECK_FALSE(table.lookup(0.99f * radius, result));
+        CHECK_FALSE(table.lookup(radius * 1025, result));
+        CHECK_FALSE(table.lookup(std::numeric_limits<float>::quiet_NaN()
+            , result));
+        CHECK_FALSE(table.lookup(std::numeric_limits<float>::infinity()
+            , result));
+        // Unchanged
+        check_equal(result, expected);
+    }
+}
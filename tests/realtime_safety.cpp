@@ -0,0 +1,203 @@
+/******************************************************************************
+ * Copyright © 2019 SSR Contributors                                          *
+ *                                                                            *
+ * This file is part of the SoundScape Renderer (SSR).                        *
+ *                                                                            *
+ * The SSR is free software:  you can redistribute it and/or modify it  under *
+ * the terms of the  GNU  General  Public  License  as published by the  Free *
+ * Software Foundation, either version 3 of the License,  or (at your option) *
+ * any later version.                                                         *
+ *                                                                            *
+ * The SSR is distributed in the hope that it will be useful, but WITHOUT ANY *
+ * WARRANTY;  without even the implied warranty of MERCHANTABILITY or FITNESS *
+ * FOR A PARTICULAR PURPOSE.                                                  *
+ * See the GNU General Public License for more details.                       *
+ *                                                                            *
+ * You should  have received a copy  of the GNU General Public License  along *
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                            *
+ * The SSR is a tool  for  real-time  spatial audio reproduction  providing a *
+ * variety of rendering algorithms.                                           *
+ *                                                                            *
+ * http://spatialaudio.net/ssr                           ssr@spatialaudio.net *
+ ******************************************************************************/
+
+/// @file
+/// Drive all renderers through audio_callback() and check that no
+/// realtime-unsafe functions are called in the audio threads.
+///
+/// This is only built with ./configure --enable-rtcheck, see src/rtcheck.h.
+
+#include <cmath>  // for std::cos(), std::sin()
+#include <cstdlib>  // for EXIT_SUCCESS, EXIT_FAILURE
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sndfile.hh>
+#include <vector>
+
+#include "apf/pointer_policy.h"
+
+#include "aaprenderer.h"
+#include "binauralrenderer.h"
+#include "brsrenderer.h"
+#include "dcarenderer.h"
+#include "genericrenderer.h"
+#include "hoarenderer.h"
+#include "vbaprenderer.h"
+#include "wfsrenderer.h"
+
+#include "rtcheck.h"
+
+namespace
+{
+
+const size_t sample_rate = 44100;
+const size_t block_size = 256;
+const size_t loudspeakers = 8;
+const size_t sources = 4;
+const size_t blocks = 50;
+
+std::string temp_file(const std::string& name)
+{
+  return (std::filesystem::temp_directory_path() / name).string();
+}
+
+std::string write_setup()
+{
+  auto file_name = temp_file("ssr_realtime_safety_setup.asd");
+  std::ofstream setup(file_name);
+  setup << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+    "<asdf>\n"
+    "  <reproduction_setup>\n"
+    "    <circular_array number=\"" << loudspeakers << "\">\n"
+    "      <first>\n"
+    "        <position x=\"2\" y=\"0\"/>\n"
+    "        <orientation azimuth=\"-180\"/>\n"
+    "      </first>\n"
+    "    </circular_array>\n"
+    "  </reproduction_setup>\n"
+    "</asdf>\n";
+  return file_name;
+}
+
+/// Impulse responses for the generic renderer (one Dirac per loudspeaker).
+std::string write_generic_irs()
+{
+  auto file_name = temp_file("ssr_realtime_safety_generic.wav");
+  auto file = SndfileHandle(file_name, SFM_WRITE
+      , SF_FORMAT_WAV | SF_FORMAT_FLOAT, loudspeakers, sample_rate);
+  auto data = std::vector<float>(64 * loudspeakers);
+  for (size_t i = 0; i < loudspeakers; ++i)
+  {
+    data[i * loudspeakers + i] = 1.0f;
+  }
+  file.writef(data.data(), 64);
+  return file_name;
+}
+
+/** Create a few sources, move them around while calling audio_callback().
+ * @return number of realtime-unsafe calls
+ **/
+template<typename Renderer>
+size_t run(const std::string& name, apf::parameter_map params
+    , const apf::parameter_map& source_params = apf::parameter_map())
+{
+  params.set("sample_rate", sample_rate);
+  params.set("block_size", block_size);
+  params.set("threads", 2);  // to include the worker threads
+
+  Renderer renderer(params);
+  renderer.load_reproduction_setup();
+
+  auto ids = std::vector<std::string>();
+  for (size_t i = 0; i < sources; ++i)
+  {
+    auto id = renderer.add_source("", source_params);
+    auto* source = renderer.get_source(id);
+    source->model = i % 2 ? ssr::SourceModel::plane : ssr::SourceModel::point;
+    source->active = true;
+    ids.push_back(id);
+  }
+
+  auto input_data = std::vector<std::vector<float>>(sources
+      , std::vector<float>(block_size, 0.1f));
+  auto output_data = std::vector<std::vector<float>>(
+      renderer.get_output_list().size(), std::vector<float>(block_size));
+
+  auto inputs = std::vector<float*>();
+  for (auto& channel: input_data) inputs.push_back(channel.data());
+  auto outputs = std::vector<float*>();
+  for (auto& channel: output_data) outputs.push_back(channel.data());
+
+  auto before = ssr::rtcheck::violations();
+
+  renderer.activate();
+
+  for (size_t block = 0; block < blocks; ++block)
+  {
+    for (size_t i = 0; i < sources; ++i)
+    {
+      float angle = 2 * apf::math::pi<float>() * (i + 0.01f * block) / sources;
+      renderer.get_source(ids[i])->position
+        = Pos{3 * std::cos(angle), 3 * std::sin(angle)};
+    }
+    renderer.state.reference_rotation = Rot(Orientation(block));
+    renderer.audio_callback(block_size, inputs.data(), outputs.data());
+    // The renderer marks the calling thread as realtime thread
+    ssr::rtcheck::unmark_realtime_thread();
+  }
+
+  renderer.deactivate();
+
+  // NB: Worker threads stay marked until they are terminated in the renderer's
+  //     destructor, calls made during their shutdown are not counted.
+  auto violations = ssr::rtcheck::violations() - before;
+  std::cout << name << ": " << violations << " realtime-unsafe call(s)"
+    << std::endl;
+  return violations;
+}
+
+}  // unnamed namespace
+
+int main()
+{
+  ssr::rtcheck::set_abort(false);  // show all violations
+
+  XMLParser::Init();
+
+  auto setup = write_setup();
+  auto hrirs = std::string(SSR_DATA_DIR
+      "/impulse_responses/hrirs/hrirs_fabian_min_phase_eq.wav");
+
+  apf::parameter_map loudspeaker_params;
+  loudspeaker_params.set("reproduction_setup", setup);
+
+  apf::parameter_map wfs_params = loudspeaker_params;
+  wfs_params.set("prefilter_file", SSR_DATA_DIR
+      "/impulse_responses/wfs_prefilters/wfs_prefilter_120_1500_44100.wav");
+
+  apf::parameter_map binaural_params;
+  binaural_params.set("hrir_file", hrirs);
+
+  // The HRIRs have the same format as BRIRs (360 pairs of channels)
+  apf::parameter_map brs_source_params;
+  brs_source_params.set("properties-file", hrirs);
+
+  apf::parameter_map generic_source_params;
+  generic_source_params.set("properties-file", write_generic_irs());
+
+  size_t violations = 0;
+  violations += run<ssr::AapRenderer>("AAP", loudspeaker_params);
+  violations += run<ssr::BinauralRenderer>("binaural", binaural_params);
+  violations += run<ssr::BrsRenderer>("BRS", apf::parameter_map()
+      , brs_source_params);
+  violations += run<ssr::DcaRenderer>("DCA", loudspeaker_params);
+  violations += run<ssr::GenericRenderer>("generic", loudspeaker_params
+      , generic_source_params);
+  violations += run<ssr::HoaRenderer>("HOA", loudspeaker_params);
+  violations += run<ssr::VbapRenderer>("VBAP", loudspeaker_params);
+  violations += run<ssr::WfsRenderer>("WFS", wfs_params);
+
+  return violations == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,102 @@
+#include "catch/catch.hpp"
+
+#include <vector>
+
+#include "sourcearena.h"
+
+using ssr::SourceArena;
+
+TEST_CASE("SourceArena") {
+
+    SourceArena arena(64 * 1024);
+
+    SECTION("without Scope, the heap is used") {
+        auto* ptr = SourceArena::allocate(100);
+        CHECK(arena.slabs() == 0);
+        SourceArena::deallocate(ptr);
+    }
+
+    SECTION("small allocations share one slab") {
+        SourceArena::Scope scope(arena);
+        auto* first = static_cast<char*>(SourceArena::allocate(100));
+        auto* second = static_cast<char*>(SourceArena::allocate(100));
+        CHECK(arena.slabs() == 1);
+        // Contiguous, apart from the header and alignment
+        CHECK(second > first);
+        CHECK(second - first < 200);
+        CHECK(reinterpret_cast<uintptr_t>(first) % SourceArena::alignment
+            == 0);
+        CHECK(reinterpret_cast<uintptr_t>(second) % SourceArena::alignment
+            == 0);
+        SourceArena::deallocate(first);
+        SourceArena::deallocate(second);
+    }
+
+    SECTION("the current slab is reused when everything is given back") {
+        SourceArena::Scope scope(arena);
+        auto* first = SourceArena::allocate(100);
+        SourceArena::deallocate(first);
+        auto* second = SourceArena::allocate(100);
+        CHECK(second == first);
+        CHECK(arena.slabs() == 1);
+        SourceArena::deallocate(second);
+    }
+
+    SECTION("full slabs are freed when everything is given back") {
+        SourceArena::Scope scope(arena);
+        auto pointers = std::vector<void*>();
+        for (int i = 0; i < 100; ++i) {
+            pointers.push_back(SourceArena::allocate(1000));
+        }
+        CHECK(arena.slabs() == 2);
+        for (int i = 0; i < 99; ++i) {
+            SourceArena::deallocate(pointers[i]);
+        }
+        CHECK(arena.slabs() == 1);
+        SourceArena::deallocate(pointers[99]);
+        CHECK(arena.slabs() == 1);  // the current slab is kept
+    }
+
+    SECTION("large allocations get their own slab") {
+        SourceArena::Scope scope(arena);
+        auto* small = SourceArena::allocate(100);
+        auto* large = SourceArena::allocate(32 * 1024);
+        CHECK(arena.slabs() == 2);
+        SourceArena::deallocate(large);
+        CHECK(arena.slabs() == 1);
+        SourceArena::deallocate(small);
+    }
+
+    SECTION("Scopes can be nested") {
+        SourceArena other(64 * 1024);
+        {
+            SourceArena::Scope scope(arena);
+            {
+                SourceArena::Scope inner(other);
+                SourceArena::deallocate(SourceArena::allocate(100));
+            }
+            auto* ptr = SourceArena::allocate(100);
+            SourceArena::deallocate(ptr);
+        }
+        CHECK(other.slabs() == 1);
+        CHECK(arena.slabs() == 1);
+    }
+
+    SECTION("slab size 0 disables the arena") {
+        SourceArena disabled(0);
+        SourceArena::Scope scope(disabled);
+        SourceArena::deallocate(SourceArena::allocate(100));
+        CHECK(disabled.slabs() == 0);
+    }
+
+    SECTION("huge pages") {
+        SourceArena huge(64 * 1024, true);
+        SourceArena::Scope scope(huge);
+        auto* ptr = static_cast<char*>(SourceArena::allocate(100));
+        // The slab (which starts before the first allocation) is aligned to
+        // a huge page
+        CHECK(reinterpret_cast<uintptr_t>(ptr) % SourceArena::huge_page_size
+            < 256);
+        SourceArena::deallocate(ptr);
+    }
+}
@@ -0,0 +1,28 @@
+#include "catch/catch.hpp"
+
+#include "threadlayout.h"
+
+using V = std::vector<int>;
+
+TEST_CASE("ThreadLayout::parse_cpu_list") {
+
+    constexpr auto f = ssr::ThreadLayout::parse_cpu_list;
+
+    SECTION("single CPUs and ranges") {
+        CHECK(f("0") == V{0});
+        CHECK(f("0-3,8") == V{0, 1, 2, 3, 8});
+        CHECK(f("10-11,2") == V{10, 11, 2});
+        CHECK(f("4-4") == V{4});
+    }
+
+    SECTION("empty list") {
+        CHECK(f("").empty());
+        CHECK(f(",").empty());
+    }
+
+    SECTION("invalid items are skipped") {
+        CHECK(f("a,1,2-b,3") == V{1, 3});
+        CHECK(f("1-,-2,5") == V{5});
+        CHECK(f("3-1") == V{});
+    }
+}
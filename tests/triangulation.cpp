@@ -0,0 +1,105 @@
+#include "catch/catch.hpp"
+
+#include <cmath>  // for std::sqrt()
+
+#include "triangulation.h"
+
+using ssr::vec3;
+using ssr::triangulate;
+using ssr::find_triangle;
+
+namespace {
+
+std::vector<vec3> octahedron()
+{
+    return {
+        {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+}
+
+float sum_of_squares(const std::array<float, 3>& gains)
+{
+    return gains[0] * gains[0] + gains[1] * gains[1] + gains[2] * gains[2];
+}
+
+}  // unnamed namespace
+
+TEST_CASE("triangulate") {
+
+    SECTION("octahedron") {
+        auto triangles = triangulate(octahedron());
+        CHECK(triangles.size() == 8);
+
+        // Each loudspeaker is part of 4 triangles
+        auto count = std::vector<int>(6);
+        for (const auto& triangle: triangles) {
+            for (auto ls: triangle.loudspeakers) {
+                ++count[ls];
+            }
+        }
+        CHECK(count == std::vector<int>(6, 4));
+    }
+
+    SECTION("the base of a dome is dropped") {
+        auto directions = octahedron();
+        directions.pop_back();  // no loudspeaker at the bottom
+        auto triangles = triangulate(directions);
+        CHECK(triangles.size() == 4);
+    }
+
+    SECTION("no triangles") {
+        CHECK_THROWS_AS(triangulate({}), std::logic_error);
+        CHECK_THROWS_AS(triangulate({{1, 0, 0}, {0, 1, 0}})
+            , std::logic_error);
+    }
+}
+
+TEST_CASE("find_triangle") {
+
+    auto directions = octahedron();
+    auto triangles = triangulate(directions);
+
+    SECTION("loudspeaker directions") {
+        for (size_t ls = 0; ls < directions.size(); ++ls) {
+            auto [t, gains] = find_triangle(triangles, directions[ls]);
+            for (size_t i = 0; i < 3; ++i) {
+                bool is_ls = triangles[t].loudspeakers[i] == ls;
+                CHECK(gains[i] == Approx(is_ls ? 1.0f : 0.0f).margin(1e-6));
+            }
+        }
+    }
+
+    SECTION("center of a triangle") {
+        auto direction = vec3{1, 1, 1} / std::sqrt(3.0f);
+        auto [t, gains] = find_triangle(triangles, direction);
+        for (auto gain: gains) {
+            CHECK(gain == Approx(1 / std::sqrt(3.0f)));
+        }
+    }
+
+    SECTION("gains are normalized to constant power") {
+        for (auto direction: {vec3{0.3f, -0.2f, 0.9f}, vec3{-1, 2, 3}
+                , vec3{0.1f, 0.1f, -5}, vec3{-4, -0.5f, 0.2f}}) {
+            auto [t, gains] = find_triangle(triangles, direction);
+            CHECK(sum_of_squares(gains) == Approx(1.0f));
+            for (auto gain: gains) {
+                CHECK(gain >= 0);
+            }
+        }
+    }
+
+    SECTION("directions outside of a dome") {
+        directions.pop_back();  // no loudspeaker at the bottom
+        triangles = triangulate(directions);
+        auto [t, gains] = find_triangle(triangles, vec3{1, 1, -1});
+        CHECK(sum_of_squares(gains) == Approx(1.0f));
+        for (auto gain: gains) {
+            CHECK(gain >= 0);
+        }
+        // Only the horizontal loudspeakers get a signal
+        for (size_t i = 0; i < 3; ++i) {
+            if (triangles[t].loudspeakers[i] == 4) {
+                CHECK(gains[i] == 0);
+            }
+        }
+    }
+}
@@ -0,0 +1,178 @@
+/******************************************************************************
+ * Copyright © 2019 SSR Contributors                                          *
+ *                                                                            *
+ * This file is part of the SoundScape Renderer (SSR).                        *
+ *                                                                            *
+ * The SSR is free software:  you can redistribute it and/or modify it  under *
+ * the terms of the  GNU  General  Public  License  as published by the  Free *
+ * Software Foundation, either version 3 of the License,  or (at your option) *
+ * any later version.                                                         *
+ *                                                                            *
+ * The SSR is distributed in the hope that it will be useful, but WITHOUT ANY *
+ * WARRANTY;  without even the implied warranty of MERCHANTABILITY or FITNESS *
+ * FOR A PARTICULAR PURPOSE.                                                  *
+ * See the GNU General Public License for more details.                       *
+ *                                                                            *
+ * You should  have received a copy  of the GNU General Public License  along *
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.            *
+ *                                                                            *
+ * The SSR is a tool  for  real-time  spatial audio reproduction  providing a *
+ * variety of rendering algorithms.                                           *
+ *                                                                            *
+ * http://spatialaudio.net/ssr                           ssr@spatialaudio.net *
+ ******************************************************************************/
+
+/// @file
+
+/// @file
+/// Check that pipelined WFS processing gives the same result as
+/// non-pipelined processing, delayed by one block.
+
+#include <algorithm>  // for std::max()
+#include <cmath>  // for std::abs(), std::cos(), std::sin()
+#include <cstdlib>  // for EXIT_SUCCESS, EXIT_FAILURE
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "apf/pointer_policy.h"
+#include "wfsrenderer.h"
+
+namespace
+{
+
+const size_t sample_rate = 44100;
+const size_t block_size = 256;
+const size_t loudspeakers = 16;
+const size_t sources = 4;
+const size_t blocks = 40;
+
+using signal_t = std::vector<std::vector<float>>;  // [block][channel/sample]
+
+std::string write_setup()
+{
+  auto file_name = (std::filesystem::temp_directory_path()
+      / "ssr_wfs_pipeline_setup.asd").string();
+  std::ofstream setup(file_name);
+  setup << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+    "<asdf>\n"
+    "  <reproduction_setup>\n"
+    "    <circular_array number=\"" << loudspeakers << "\">\n"
+    "      <first>\n"
+    "        <position x=\"2\" y=\"0\"/>\n"
+    "        <orientation azimuth=\"-180\"/>\n"
+    "      </first>\n"
+    "    </circular_array>\n"
+    "  </reproduction_setup>\n"
+    "</asdf>\n";
+  return file_name;
+}
+
+/** Render noise with moving sources.
+ * @return One vector per block, containing all output channels
+ **/
+signal_t render(bool pipelined)
+{
+  apf::parameter_map params;
+  params.set("sample_rate", sample_rate);
+  params.set("block_size", block_size);
+  params.set("threads", 2);
+  params.set("reproduction_setup", write_setup());
+  params.set("prefilter_file", SSR_DATA_DIR
+      "/impulse_responses/wfs_prefilters/wfs_prefilter_120_1500_44100.wav");
+  params.set("initial_delay", 1000);
+  // Pipelined mode always mixes in tiles, the same tiles are used without
+  // pipelining to get the same order of summation
+  params.set("mixing_tile_outputs", 4);
+  params.set("pipelined", pipelined);
+
+  ssr::WfsRenderer renderer(params);
+  renderer.load_reproduction_setup();
+
+  auto ids = std::vector<std::string>();
+  for (size_t i = 0; i < sources; ++i)
+  {
+    auto id = renderer.add_source("");
+    auto* source = renderer.get_source(id);
+    source->model = i % 2 ? ssr::SourceModel::plane : ssr::SourceModel::point;
+    source->active = true;
+    ids.push_back(id);
+  }
+
+  // Same noise for both runs
+  auto generator = std::mt19937();
+  auto distribution = std::uniform_real_distribution<float>(-0.5f, 0.5f);
+
+  auto input_data = std::vector<std::vector<float>>(sources
+      , std::vector<float>(block_size));
+  auto output_data = std::vector<std::vector<float>>(loudspeakers
+      , std::vector<float>(block_size));
+
+  auto inputs = std::vector<float*>();
+  for (auto& channel: input_data) inputs.push_back(channel.data());
+  auto outputs = std::vector<float*>();
+  for (auto& channel: output_data) outputs.push_back(channel.data());
+
+  auto result = signal_t();
+
+  renderer.activate();
+
+  for (size_t block = 0; block < blocks; ++block)
+  {
+    for (auto& channel: input_data)
+    {
+      for (auto& sample: channel) sample = distribution(generator);
+    }
+    for (size_t i = 0; i < sources; ++i)
+    {
+      float angle = 2 * apf::math::pi<float>() * (i + 0.05f * block) / sources;
+      renderer.get_source(ids[i])->position
+        = Pos{3 * std::cos(angle), 3 * std::sin(angle)};
+    }
+    renderer.audio_callback(block_size, inputs.data(), outputs.data());
+
+    result.emplace_back();
+    for (auto& channel: output_data)
+    {
+      result.back().insert(result.back().end(), channel.begin(), channel.end());
+    }
+  }
+
+  renderer.deactivate();
+  return result;
+}
+
+}  // unnamed namespace
+
+int main()
+{
+  XMLParser::Init();
+
+  auto reference = render(false);
+  auto pipelined = render(true);
+
+  float max_error = 0, max_value = 0;
+  for (size_t block = 1; block < blocks; ++block)
+  {
+    const auto& expected = reference[block - 1];
+    const auto& actual = pipelined[block];
+    for (size_t n = 0; n < expected.size(); ++n)
+    {
+      max_error = std::max(max_error, std::abs(actual[n] - expected[n]));
+      max_value = std::max(max_value, std::abs(expected[n]));
+    }
+  }
+
+  std::cout << "pipelined vs. non-pipelined (delayed by one block): "
+    << "max. error " << max_error << ", max. value " << max_value
+    << std::endl;
+
+  if (max_value == 0)
+  {
+    std::cout << "Error: no output signal" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return max_error <= 1e-5f * max_value ? EXIT_SUCCESS : EXIT_FAILURE;
+}